@@ -63,6 +63,7 @@ void reaction_timer(void)
             {
                 printf("\nNo input detected for 5 seconds. Game ended.\n");
                 LED_cleanup();
+                joystick_cleanup();
                 return;
             }
             usleep(100000); // 100ms
@@ -155,4 +156,5 @@ void reaction_timer(void)
 
     // Cleanup
     LED_cleanup();
+    joystick_cleanup();
 }
\ No newline at end of file
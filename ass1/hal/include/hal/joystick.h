@@ -14,6 +14,7 @@ typedef enum
 
 // Function prototypes
 void joystick_init(void);
+void joystick_cleanup(void);
 void joystick_calibrate(void);
 JoystickDirection read_joystick_direction(void);
 void joystick_record_successful_move(JoystickDirection dir);
@@ -1,20 +1,15 @@
 #include "hal/joystick.h"
+#include "hal/tla2024.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <fcntl.h>
 #include <unistd.h>
-#include <sys/ioctl.h>
-#include <linux/i2c.h>
-#include <linux/i2c-dev.h>
 #include <time.h>
 
-#define I2CDRV_LINUX_BUS "/dev/i2c-1"
-#define I2C_DEVICE_ADDRESS 0x48
-#define REG_CONFIGURATION 0x01
-#define REG_DATA 0x00
-#define TLA2024_CHANNEL_CONF_0 0x83C2
-
-static int i2c_file_desc = -1;
+// Joystick is on ADC channel 0, scanned by the shared TLA2024 module
+#define JOYSTICK_CHANNEL 0
+#define JOYSTICK_SCANS_PER_SECOND 200
+#define FIRST_READING_POLL_US 1000
+#define FIRST_READING_TIMEOUT_POLLS 100
 
 // Fixed calibration values based on measured data
 static const uint16_t up_threshold = 865;     // Above this is UP movement
@@ -22,78 +17,37 @@ static const uint16_t down_threshold = 830;   // Below this is DOWN movement
 static const uint16_t left_threshold = 100;   // Clear threshold for left
 static const uint16_t right_threshold = 1500; // Clear threshold for right
 
-static int init_i2c_bus(char *bus, int address)
-{
-    int i2c_file_desc = open(bus, O_RDWR);
-
-    if (i2c_file_desc == -1)
-    {
-        printf("I2C DRV: Unable to open bus for read/write (%s)\n", bus);
-        perror("Error is:");
-        exit(EXIT_FAILURE);
-    }
-
-    if (ioctl(i2c_file_desc, I2C_SLAVE, address) == -1)
-    {
-        perror("Unable to set I2C device to slave address.");
-        exit(EXIT_FAILURE);
-    }
-    return i2c_file_desc;
-}
-
-static void write_i2c_reg16(int i2c_file_desc, uint8_t reg_addr, uint16_t value)
-{
-    int tx_size = 1 + sizeof(value);
-    uint8_t buff[tx_size];
-    buff[0] = reg_addr;
-    buff[1] = (value & 0xFF);
-    buff[2] = (value & 0xFF00) >> 8;
-    int bytes_written = write(i2c_file_desc, buff, tx_size);
-    if (bytes_written != tx_size)
-    {
-        perror("Unable to write i2c register");
-        exit(EXIT_FAILURE);
-    }
-}
-
-static uint16_t read_i2c_reg16(int i2c_file_desc, uint8_t reg_addr)
+void joystick_init(void)
 {
-    int bytes_written = write(i2c_file_desc, &reg_addr, sizeof(reg_addr));
-    if (bytes_written != sizeof(reg_addr))
+    if (!Tla2024_openChannel(JOYSTICK_CHANNEL, JOYSTICK_SCANS_PER_SECOND))
     {
-        perror("Unable to write i2c register.");
+        printf("Failed to open the joystick ADC\n");
         exit(EXIT_FAILURE);
     }
 
-    uint16_t value = 0;
-    int bytes_read = read(i2c_file_desc, &value, sizeof(value));
-    if (bytes_read != sizeof(value))
+    // An empty slot would read as a full-left joystick
+    for (int i = 0; i < FIRST_READING_TIMEOUT_POLLS; i++)
     {
-        perror("Unable to read i2c register");
-        exit(EXIT_FAILURE);
+        if (Tla2024_read(JOYSTICK_CHANNEL).sequence != 0)
+        {
+            return;
+        }
+        usleep(FIRST_READING_POLL_US);
     }
-    return value;
+    printf("No reading from the joystick ADC\n");
+    exit(EXIT_FAILURE);
 }
 
-void joystick_init(void)
+void joystick_cleanup(void)
 {
-    i2c_file_desc = init_i2c_bus(I2CDRV_LINUX_BUS, I2C_DEVICE_ADDRESS);
-    if (i2c_file_desc == -1)
-    {
-        perror("Failed to open I2C bus");
-        exit(EXIT_FAILURE);
-    }
-
-    write_i2c_reg16(i2c_file_desc, REG_CONFIGURATION, TLA2024_CHANNEL_CONF_0);
+    Tla2024_closeChannel(JOYSTICK_CHANNEL);
 }
 
 JoystickDirection read_joystick_direction(void)
 {
 
-    // Read and process joystick value
-    uint16_t raw_value = read_i2c_reg16(i2c_file_desc, REG_DATA);
-    uint16_t processed_value = ((raw_value & 0xFF) << 8) | ((raw_value & 0xFF00) >> 8);
-    processed_value >>= 4;
+    // Latest joystick value from the shared ADC
+    uint16_t processed_value = Tla2024_read(JOYSTICK_CHANNEL).code;
 
     // Determine direction using fixed thresholds
     JoystickDirection dir;
@@ -3,8 +3,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <unistd.h>
 #include "hal/sampler.h"
+#include "hal/sample_recorder.h"
+#include "hal/light_source.h"
 #include "hal/udp_server.h"
 #include "hal/periodTimer.h"
 #include "hal/pwm_led.h"
@@ -16,6 +19,11 @@
 #define MAX_LCD_MESSAGE 1024 // Increased buffer size like example
 #define NAME "Omar n Wes"
 #define MAX_FREQUENCY 500.0
+#define DEFAULT_SAMPLE_RATE_HZ 1000
+#define MAX_SAMPLE_RATE_HZ 3300
+#define MAX_OVERSAMPLING 64
+#define RECORDING_SECONDS (60 * 60) // Recording keeps the last hour of samples
+#define SYNTHETIC_NOISE_VOLTS 0.01
 
 static void process_rotary(void)
 {
@@ -50,20 +58,91 @@ static void process_rotary(void)
     }
 }
 
-int main()
+// Usage: light_sampler [samples/s[xoversampling]] [recording file | -] [light source]
+// e.g. 1000x3 outputs 1000 samples/s, each averaged from 3 ADC reads.
+// Light source: tla2024 (default), synthetic[:dip Hz], or replay:<recording file>
+static int parse_sample_rate(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        return DEFAULT_SAMPLE_RATE_HZ;
+    }
+
+    int rate = 0;
+    int oversampling = 1;
+    int num_parsed = sscanf(argv[1], "%dx%d", &rate, &oversampling);
+    if (num_parsed < 1 || rate < 1 || rate > MAX_SAMPLE_RATE_HZ)
+    {
+        printf("Invalid sample rate '%s' (1 to %d); using %d\n",
+               argv[1], MAX_SAMPLE_RATE_HZ, DEFAULT_SAMPLE_RATE_HZ);
+        return DEFAULT_SAMPLE_RATE_HZ;
+    }
+
+    if (oversampling < 1 || oversampling > MAX_OVERSAMPLING ||
+        rate * oversampling > MAX_SAMPLE_RATE_HZ)
+    {
+        printf("Invalid oversampling in '%s' (1 to %d, at most %d reads/s); not oversampling\n",
+               argv[1], MAX_OVERSAMPLING, MAX_SAMPLE_RATE_HZ);
+        oversampling = 1;
+    }
+    Sampler_setOversampling(oversampling);
+    return rate;
+}
+
+static void select_source(int argc, char *argv[])
+{
+    if (argc < 4 || strcmp(argv[3], "tla2024") == 0)
+    {
+        return;
+    }
+
+    if (strncmp(argv[3], "synthetic", strlen("synthetic")) == 0)
+    {
+        const char *pHz = strchr(argv[3], ':');
+        if (pHz)
+        {
+            LightSource_configureSynthetic(atof(pHz + 1), SYNTHETIC_NOISE_VOLTS);
+        }
+        Sampler_setSource(&LightSource_synthetic);
+    }
+    else if (strncmp(argv[3], "replay:", strlen("replay:")) == 0)
+    {
+        LightSource_configureReplay(argv[3] + strlen("replay:"));
+        Sampler_setSource(&LightSource_replay);
+    }
+    else
+    {
+        printf("Unknown light source '%s'; using tla2024\n", argv[3]);
+    }
+}
+
+int main(int argc, char *argv[])
 {
     printf("Starting Light Sensor Sampling...\n");
+    int sample_rate = parse_sample_rate(argc, argv);
+
+    // Optionally record every sample for post-mortem analysis
+    if (argc >= 3 && strcmp(argv[2], "-") != 0)
+    {
+        SampleRecorder_init(argv[2], (uint64_t)sample_rate * RECORDING_SECONDS,
+                            Sampler_codeToVoltage(1));
+    }
 
     // Initialize all modules; HAL modules first
     Gpio_initialize();
     Period_init();
-    Sampler_init();
+    select_source(argc, argv);
+    Sampler_init(sample_rate);
     UdpServer_init();
     PwmLed_init();
     LcdDisplayImpl_init();
     TerminalDisplay_init();
     RotaryEncoder_init();
 
+    // The terminal display reads the same timing stats; each of us gets
+    // the whole second
+    Period_reader_t *pPeriodReader = Period_openReader(PERIOD_EVENT_SAMPLE_LIGHT);
+
     // Main loop: Process rotary encoder and update LCD
     while (!UdpServer_shouldStop())
     {
@@ -73,11 +152,13 @@ int main()
 
         // Get statistics and update display
         Period_statistics_t stats;
-        Period_getStatisticsAndClear(PERIOD_EVENT_SAMPLE_LIGHT, &stats);
+        Period_getStatistics(pPeriodReader, &stats);
 
         // Get and verify values
         double freq = PwmLed_getFrequency();
-        int dips = Sampler_getDips();
+        Sampler_snapshot_t snapshot;
+        Sampler_getSnapshot(&snapshot);
+        int dips = snapshot.dips;
 
         // Format message for LCD with more information
         char buff[MAX_LCD_MESSAGE];
@@ -95,6 +176,7 @@ int main()
     }
 
     printf("Starting cleanup...\n");
+    Period_closeReader(pPeriodReader);
 
     RotaryEncoder_cleanup();
 
@@ -112,6 +194,7 @@ int main()
 
     printf("Stopping sampler...\n");
     Sampler_cleanup();
+    SampleRecorder_cleanup();
 
     printf("Stopping period timer...\n");
     Period_cleanup();
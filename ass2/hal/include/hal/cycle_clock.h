@@ -0,0 +1,51 @@
+// Module for cheap timestamps from the CPU's free-running counter:
+// CNTVCT_EL0 on aarch64 (the BeagleY-AI's Cortex-A53), the TSC on x86-64
+// hosts, and CLOCK_MONOTONIC elsewhere.
+//
+// Reading the counter takes a few ns and no system call, so hot paths can
+// stamp events freely and convert to nanoseconds only when reporting.
+// The counter is calibrated once against CLOCK_MONOTONIC by
+// CycleClock_init(). Ticks from different cores are comparable (both
+// counters are invariant and synchronized across cores), but the
+// unserialized read may be reordered by a few instructions.
+#ifndef _CYCLE_CLOCK_H_
+#define _CYCLE_CLOCK_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Calibrate the counter. Safe to call more than once, from any thread;
+// only the first call does the work (which takes about 10 ms on x86).
+void CycleClock_init(void);
+
+// Read the counter, in ticks. Inline so hot paths pay for the read only.
+static inline uint64_t CycleClock_now(void)
+{
+#if defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#elif defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+// Nanoseconds per tick. Requires CycleClock_init().
+double CycleClock_nsPerTick(void);
+
+// Convert a number of ticks (e.g. the difference between two readings)
+// to nanoseconds. Requires CycleClock_init().
+double CycleClock_ticksToNs(uint64_t ticks);
+
+// Convert a reading to CLOCK_MONOTONIC time in ns. Requires CycleClock_init().
+long long CycleClock_toMonotonicNs(uint64_t ticks);
+
+#endif
@@ -0,0 +1,69 @@
+// Wire format of the UDP server's binary replies ("history binary" and
+// "range <start> <count>").
+//
+// One second of history is sent as one or more datagrams (fragments).
+// Each starts with a HistoryPacket_header_t and is followed by num_samples
+// int16 samples in millivolts. Every field is little-endian.
+// A client reassembles a second by `sequence`, placing each fragment at
+// `first_sample`; a missing fragment_index means a datagram was lost.
+//
+// A range reply is one or more pages, each a RangePacket_header_t followed
+// by num_samples int16 millivolt samples. Samples are addressed by absolute
+// index since the sampler started, so each page's first_index is a cursor:
+// every page names the span of the whole reply, and a client re-requests
+// "range <first> <count>" for any part of it that did not arrive. A reply
+// that ends before the requested count is resumed from reply_end_index.
+#ifndef _HISTORY_PACKET_H_
+#define _HISTORY_PACKET_H_
+
+#include <stdint.h>
+
+#define HISTORY_PACKET_MAGIC 0x54534948 // "HIST" on the wire
+#define HISTORY_PACKET_VERSION 1
+
+// Largest datagram sent, so it never needs IP fragmentation on Ethernet
+#define HISTORY_PACKET_MAX_SIZE 1472
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t fragment_index;
+    uint8_t fragment_count;
+    uint32_t sequence;           // History generation this second belongs to
+    uint32_t sample_rate_hz;
+    int64_t first_timestamp_ns;  // CLOCK_MONOTONIC time of the second's first sample
+    uint16_t total_samples;      // Samples in the whole second
+    uint16_t first_sample;       // Index of this fragment's first sample
+    uint16_t num_samples;        // Samples in this fragment
+    uint16_t reserved;
+} HistoryPacket_header_t;
+
+_Static_assert(sizeof(HistoryPacket_header_t) == 32, "history packet header has padding");
+
+#define HISTORY_PACKET_MAX_SAMPLES \
+    ((HISTORY_PACKET_MAX_SIZE - sizeof(HistoryPacket_header_t)) / sizeof(int16_t))
+
+#define RANGE_PACKET_MAGIC 0x45474e52 // "RNGE" on the wire
+#define RANGE_PACKET_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_samples;        // Samples in this page
+    int64_t first_index;         // Index of this page's first sample
+    int64_t reply_first_index;   // Span of the whole reply: [first, end)
+    int64_t reply_end_index;
+    int64_t oldest_index;        // Oldest sample the server still retains
+    int64_t end_index;           // One past the newest sample taken
+    int64_t first_timestamp_ns;  // CLOCK_MONOTONIC time of this page's first sample
+    uint32_t sample_rate_hz;
+    uint16_t page_index;         // Page within the reply
+    uint16_t page_count;
+} RangePacket_header_t;
+
+_Static_assert(sizeof(RangePacket_header_t) == 64, "range packet header has padding");
+
+#define RANGE_PACKET_MAX_SAMPLES \
+    ((HISTORY_PACKET_MAX_SIZE - sizeof(RangePacket_header_t)) / sizeof(int16_t))
+
+#endif
@@ -0,0 +1,51 @@
+// Interface to the sources the Sampler can read light levels from.
+//
+// The Sampler calls open() once before sampling starts, read() once per
+// sample, and close() at cleanup. Each source is a module-level singleton;
+// pick one with Sampler_setSource() before Sampler_init().
+//
+// Sources that do not touch hardware generate their data from the sample
+// timestamp they are given, so they work the same whether the Sampler runs
+// in real time or faster (see Sampler_initManual()).
+#ifndef _LIGHT_SOURCE_H_
+#define _LIGHT_SOURCE_H_
+
+#include <stdint.h>
+
+// How often a source could not deliver a fresh reading (totals since open())
+typedef struct {
+    long long stale_reads;      // read() repeated a reading it had already returned
+    long long skipped_readings; // readings the hardware made that read() never returned
+} LightSource_stats_t;
+
+typedef struct {
+    const char *name;
+
+    // Prepare to deliver `samples_per_second` samples a second.
+    // Exits the program on failure, like the other HAL modules.
+    void (*open)(int samples_per_second);
+
+    // Return the next raw 12-bit ADC code, which may mean waiting for it.
+    // `timestamp_ns` is the CLOCK_MONOTONIC (or simulated) time of the
+    // request; the Sampler stamps the sample when read() returns.
+    uint16_t (*read)(long long timestamp_ns);
+
+    void (*close)(void);
+
+    // Optional (NULL for sources that generate every reading on demand).
+    void (*get_stats)(LightSource_stats_t *pStats);
+} LightSource_t;
+
+// Zen Hat light sensor: TLA2024 ADC channel 2 on /dev/i2c-1, address 0x48.
+extern const LightSource_t LightSource_tla2024;
+
+// Steady light level with square-wave dips at `dip_hz` (0 for none),
+// plus uniform noise of up to +/- `noise_volts`.
+extern const LightSource_t LightSource_synthetic;
+void LightSource_configureSynthetic(double dip_hz, double noise_volts);
+
+// Replays the codes from a SampleRecorder recording, looping at the end.
+extern const LightSource_t LightSource_replay;
+void LightSource_configureReplay(const char *path);
+
+#endif
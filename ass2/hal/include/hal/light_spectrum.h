@@ -0,0 +1,27 @@
+// Module to find the dominant frequency in a window of light samples,
+// e.g. the rate the LED is actually flashing at.
+//
+// Uses a radix-2 FFT over the window (mean removed, Hann windowed and
+// zero-padded to a power of two). Twiddle factors are precomputed at init,
+// and all work buffers are allocated there, so analysis never allocates.
+// Not thread safe: call from one thread at a time.
+#ifndef _LIGHT_SPECTRUM_H_
+#define _LIGHT_SPECTRUM_H_
+
+#include <stdint.h>
+
+typedef struct {
+    double dominant_hz; // 0 if the window is too short or flat
+    double magnitude;   // Peak amplitude of that component, in ADC codes
+    int fft_size;
+} LightSpectrum_peak_t;
+
+// Prepare to analyze windows of up to `max_samples` samples.
+void LightSpectrum_init(int max_samples);
+void LightSpectrum_cleanup(void);
+
+// Analyze `size` raw ADC codes taken at `sample_rate_hz`.
+void LightSpectrum_findPeak(const uint16_t *codes, int size, int sample_rate_hz,
+                            LightSpectrum_peak_t *pPeak);
+
+#endif
@@ -10,7 +10,10 @@
 void PwmLed_init(void);
 void PwmLed_cleanup(void);
 
-// Set/get the LED flash frequency in Hz
+// Set/get the LED flash frequency in Hz.
+// setFrequency() does not wait for the hardware: a background thread
+// applies the latest value, so rapid changes collapse into one update.
+// getFrequency() returns the latest requested frequency.
 void PwmLed_setFrequency(double freq_hz);
 double PwmLed_getFrequency(void);
 
@@ -0,0 +1,29 @@
+// Module that retains the most recent raw samples, addressed by absolute
+// sample index (0 is the first sample since Sampler_init()).
+//
+// The Sampler's thread appends every sample; any thread can copy out a
+// range without locking. Keeps SAMPLE_ARCHIVE_CAPACITY samples: about
+// 4 minutes at 1000 samples/s.
+#ifndef _SAMPLE_ARCHIVE_H_
+#define _SAMPLE_ARCHIVE_H_
+
+#include <stdint.h>
+#include "hal/sampler.h"
+
+#define SAMPLE_ARCHIVE_CAPACITY (1 << 18)
+
+// Forget all samples. Must be called before the sampling thread starts.
+void SampleArchive_init(void);
+
+// Append one sample (raw ADC code, CLOCK_MONOTONIC time in ns).
+// Must only be called from the sampling thread.
+void SampleArchive_addSample(uint16_t code, long long timestamp_ns);
+
+// Copy up to `max_samples` samples starting at index `start` (or the oldest
+// retained one, if `start` has already been overwritten) into `codes` and
+// `timestamps_ns` (which may be NULL). Returns the number copied and fills
+// in `pRange`.
+int SampleArchive_read(long long start, uint16_t *codes, long long *timestamps_ns,
+                       int max_samples, Sampler_range_t *pRange);
+
+#endif
@@ -0,0 +1,28 @@
+// Module that keeps a fixed-memory pyramid of light level statistics at
+// 1 second, 1 minute and 1 hour resolution.
+//
+// The Sampler's thread feeds every sample in; each level aggregates the
+// buckets of the level below as they complete. Completed buckets are kept
+// in per-level rings and can be read by any thread without locking:
+// - seconds: last hour
+// - minutes: last day
+// - hours:   last week
+#ifndef _SAMPLE_PYRAMID_H_
+#define _SAMPLE_PYRAMID_H_
+
+#include <stdint.h>
+#include "hal/sampler.h"
+
+// Reset all levels. Must be called before the sampling thread starts.
+void SamplePyramid_init(void);
+
+// Add one sample (raw ADC code, CLOCK_MONOTONIC time in ns).
+// Must only be called from the sampling thread.
+void SamplePyramid_addSample(uint16_t code, long long timestamp_ns);
+
+// Copy up to `max_buckets` of the most recent completed buckets at
+// `resolution` into `buckets`, oldest first. Returns the number copied.
+int SamplePyramid_read(enum Sampler_resolution resolution,
+                       Sampler_bucket_t *buckets, int max_buckets);
+
+#endif
@@ -0,0 +1,48 @@
+// Module to record every light sample to disk for post-mortem analysis.
+//
+// Samples are written as fixed-size binary records into a preallocated
+// file that is memory-mapped as a ring: once full, the oldest records are
+// overwritten. Recording a sample is only a memory store; a background
+// thread flushes dirty pages to disk once a second, so the sampling
+// thread never does file I/O.
+//
+// Use tools/sample_dump to convert a recording to CSV.
+#ifndef _SAMPLE_RECORDER_H_
+#define _SAMPLE_RECORDER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// On-disk layout: one header, then `capacity` records.
+#define SAMPLE_RECORDER_MAGIC "LSAMPREC"
+#define SAMPLE_RECORDER_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t capacity;
+    double volts_per_code;
+    // Records ever written; record n is stored in slot n % capacity
+    _Atomic uint64_t num_written;
+} SampleRecorder_header_t;
+
+typedef struct {
+    int64_t timestamp_ns; // CLOCK_MONOTONIC time of the sample
+    uint16_t code;        // raw 12-bit ADC code
+    uint16_t reserved[3];
+} SampleRecorder_record_t;
+
+// Start recording into `path`, creating or resizing it to hold
+// `capacity` records. Returns false (and records nothing) on failure.
+bool SampleRecorder_init(const char *path, uint64_t capacity, double volts_per_code);
+
+// Flush what is left and close the file. Safe to call if init failed.
+void SampleRecorder_cleanup(void);
+
+// Append one sample. Does nothing unless recording was started.
+// Must only be called from the sampling thread.
+void SampleRecorder_record(uint16_t code, long long timestamp_ns);
+
+#endif
@@ -9,26 +9,180 @@
 // To make easy to work with the data, the app must call
 // Sampler_moveCurrentDataToHistory() each second to trigger this
 // module to move the current samples into the history.
+//
+// Samples are written into a small ring of one-second buffers by the
+// sampling thread only; none of the getters below ever block the sampler.
 #ifndef _SAMPLER_H_
 #define _SAMPLER_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal/light_source.h"
+
+// Sampling period statistics for one completed second, in milliseconds.
+// Jitter is the mean absolute deviation of the periods from their average.
+typedef struct {
+    int num_periods;
+    double min_period_ms;
+    double max_period_ms;
+    double avg_period_ms;
+    double jitter_ms;
+} Sampler_timing_t;
+
+// Strongest frequency in one completed second of light, found by FFT.
+// With the LED flashing this is the achieved flash rate. analysis_us is
+// how long the analysis took, to check it fits the once-a-second budget.
+typedef struct {
+    double dominant_hz; // 0 if no peak (e.g. too few samples)
+    double magnitude_volts;
+    int fft_size;
+    double analysis_us;
+} Sampler_spectrum_t;
+
+// Read-only, zero-copy view of one completed second of samples.
+// Samples are raw 12-bit ADC codes (higher code = higher voltage); convert
+// with Sampler_codeToVoltage()/Sampler_codesToVoltages() when volts are
+// needed. timestamps_ns[i] is the CLOCK_MONOTONIC time codes[i] was read.
+// `generation` increases by one each time a second moves into history.
+typedef struct {
+    const uint16_t *codes;
+    const long long *timestamps_ns;
+    int size;
+    uint32_t generation;
+    Sampler_timing_t timing;
+    Sampler_spectrum_t spectrum;
+    int dips;
+} Sampler_history_t;
+
+// Counters describing how well the sampling thread keeps its schedule.
+typedef struct {
+    long long late_wakeups;     // woke more than 1/4 period after its deadline
+    long long overruns;         // whole periods skipped because a sample ran long
+    long long dropped_samples;  // samples that did not fit in the current second
+    long long stale_reads;      // source reads that repeated an old reading
+    long long skipped_readings; // source readings never read (e.g. ADC conversions)
+} Sampler_schedule_stats_t;
+
+// Consistent picture of the sampler taken when the last second moved into
+// history: every field describes the same instant.
+typedef struct {
+    uint32_t generation;         // History generation it describes
+    int history_size;            // Samples in that second
+    int dips;                    // Dips that started in that second
+    double average_voltage;      // Running average at the end of that second
+    long long num_samples_taken; // Total samples at the end of that second
+    Sampler_timing_t timing;
+    Sampler_spectrum_t spectrum;
+    Sampler_schedule_stats_t schedule;
+} Sampler_snapshot_t;
+
+// Resolutions of the long-window statistics (see Sampler_getTrend()).
+enum Sampler_resolution {
+    SAMPLER_RESOLUTION_SECOND,
+    SAMPLER_RESOLUTION_MINUTE,
+    SAMPLER_RESOLUTION_HOUR,
+    NUM_SAMPLER_RESOLUTIONS
+};
+
+// Light level statistics for one completed second, minute or hour.
+// start_ns is the CLOCK_MONOTONIC time the bucket starts.
+typedef struct {
+    long long start_ns;
+    int count;
+    double min_voltage;
+    double max_voltage;
+    double mean_voltage;
+} Sampler_bucket_t;
+
+// Where a range of raw samples came from (see Sampler_getRange()).
+// Indices count samples since Sampler_init(), starting at 0.
+typedef struct {
+    long long first_index;   // Index of the first sample copied
+    long long oldest_index;  // Oldest sample still retained
+    long long end_index;     // One past the newest sample
+} Sampler_range_t;
+
 // Begin/end the background thread which samples light levels.
-// Thread will sample every 1ms and maintain history/statistics
-void Sampler_init(void);
+// Thread samples `samples_per_second` times a second (1 to 3300) on absolute
+// deadlines and maintains history/statistics.
+void Sampler_init(int samples_per_second);
 void Sampler_cleanup(void);
 
+// Oversample: read the source `factor` times per output sample (1 to 64, and
+// at most 3300 reads/s in total) and average each group in an integer
+// boxcar decimation filter. Reduces noise ahead of dip detection without
+// changing the output rate, history sizes or anything downstream.
+// Must be called before Sampler_init() / Sampler_initManual(); default 1.
+void Sampler_setOversampling(int factor);
+
+// Events a listener can be told about, as they happen
+enum Sampler_event {
+    SAMPLER_EVENT_HISTORY_MOVED, // From Sampler_moveCurrentDataToHistory(), after publishing
+    SAMPLER_EVENT_DIP,           // From the sampling thread, when a dip starts
+};
+typedef void (*Sampler_listener_t)(enum Sampler_event event);
+
+// Register one listener (NULL to remove). It runs on the thread raising
+// the event, so it must be quick and must not block: e.g. signal another
+// thread through an eventfd. Returns once no call to the previous listener
+// is still running, so its resources can then be released; must not be
+// called from within a listener.
+void Sampler_setListener(Sampler_listener_t listener);
+
+// Choose where samples come from (LightSource_tla2024 by default).
+// Must be called before Sampler_init() / Sampler_initManual().
+void Sampler_setSource(const LightSource_t *pSource);
+
+// Alternative to Sampler_init() with no background thread: samples are only
+// taken by Sampler_runSamples(), with timestamps advancing one period per
+// sample on a simulated clock. Lets the whole pipeline run as fast as the
+// CPU allows, e.g. with the synthetic or replay source on a host machine.
+// Call Sampler_moveCurrentDataToHistory() after each `samples_per_second`
+// samples to keep the one-second history consistent. Stop with Sampler_cleanup().
+void Sampler_initManual(int samples_per_second);
+void Sampler_runSamples(int num_samples);
+
+// Get the sample rate passed to Sampler_init().
+int Sampler_getSampleRate(void);
+
+// Get the scheduler's health counters (totals since Sampler_init()).
+void Sampler_getScheduleStats(Sampler_schedule_stats_t *pStats);
+
 // Read the current light sensor value
 void Sampler_readLightSensor(void);
 
-// Must be called once every 1s.
+// Must be called once every 1s, always from the same thread.
 // Moves the samples that it has been collecting this second into
 // the history, which makes the samples available for reads (below).
 void Sampler_moveCurrentDataToHistory(void);
 
+// Get the per-second statistics as one consistent snapshot. Published under
+// a sequence lock by Sampler_moveCurrentDataToHistory(): readers never block
+// the sampler or each other, and retry only if they overlap a publish.
+void Sampler_getSnapshot(Sampler_snapshot_t *pSnapshot);
+
 // Get the number of samples collected during the previous complete second.
 int Sampler_getHistorySize(void);
 
-// Get a copy of the samples in the sample history.
+// Fill `pHistory` with a view of the previous second's samples.
+// No allocation or copy is made; the view points into the sampler's own
+// buffers and stays usable for at least one more second. Readers that may
+// be slow should confirm with Sampler_isHistoryValid() after using it.
+void Sampler_getHistorySnapshot(Sampler_history_t *pHistory);
+
+// Generation of the newest history; cheap way to skip unchanged data.
+uint32_t Sampler_getHistoryGeneration(void);
+
+// True if the buffer behind `pHistory` has not been reused for newer samples.
+bool Sampler_isHistoryValid(const Sampler_history_t *pHistory);
+
+// Convert raw ADC codes from a history snapshot to volts.
+// The bulk version converts `count` codes into `voltages` (no overlap).
+double Sampler_codeToVoltage(uint16_t code);
+void Sampler_codesToVoltages(const uint16_t *restrict codes,
+                             double *restrict voltages, int count);
+
+// Get a copy of the samples in the sample history, in volts.
 // Returns a newly allocated array and sets `size` to be the
 // number of elements in the returned array (output-only parameter).
 // The calling code must call free() on the returned pointer.
@@ -45,10 +199,32 @@ long long Sampler_getNumSamplesTaken(void);
 // Get the number of light dips detected in the previous second's data.
 // A dip is when the light level drops 0.1V below the average and must rise
 // back to within 0.07V of the average before another dip can be detected.
+// Dips are detected by the sampling thread as samples arrive (against the
+// running average at that moment) and counted in the second they start.
 int Sampler_getDips(void);
 
-// Get timing statistics for samples in the previous second
-// All values are in milliseconds
-void Sampler_getTimingStats(double *min_ms, double *max_ms, double *avg_ms);
+// Get long-window light statistics without replaying raw samples.
+// Copies up to `max_buckets` of the most recent completed buckets at
+// `resolution` into `buckets`, oldest first, and returns how many were
+// copied. Keeps the last hour of seconds, day of minutes and week of hours.
+int Sampler_getTrend(enum Sampler_resolution resolution,
+                     Sampler_bucket_t *buckets, int max_buckets);
+
+// Get raw samples by absolute index, beyond the previous second.
+// Copies up to `max_samples` samples starting at index `start` into `codes`
+// (and `timestamps_ns`, unless NULL) and returns how many were copied.
+// If `start` is older than what is retained, the copy starts at the oldest
+// sample instead; `pRange` says what was copied and what is available.
+// Keeps the last SAMPLE_ARCHIVE_CAPACITY samples (hal/sample_archive.h).
+int Sampler_getRange(long long start, uint16_t *codes, long long *timestamps_ns,
+                     int max_samples, Sampler_range_t *pRange);
+
+// Get timing statistics for samples in the previous second, computed from
+// the per-sample timestamps when the second moved into history.
+void Sampler_getTimingStats(Sampler_timing_t *pTiming);
+
+// Get the dominant frequency of the light in the previous second, computed
+// when the second moved into history.
+void Sampler_getSpectrum(Sampler_spectrum_t *pSpectrum);
 
 #endif
\ No newline at end of file
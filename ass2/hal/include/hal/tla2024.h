@@ -0,0 +1,47 @@
+// Module that owns the Zen Hat's TLA2024 ADC (/dev/i2c-1, address 0x48)
+// and shares it between every module that needs an analog reading.
+//
+// One scan thread cycles through the open channels on a fixed schedule,
+// only rewriting the input mux (and waiting for it to settle) when more
+// than one channel is open. Each conversion is published into a lock-free
+// per-channel slot; consumers read the latest value from the slot and
+// never touch the bus, so they cannot corrupt each other's readings.
+// A consumer that needs every conversion once (the Sampler) waits for
+// each new one with Tla2024_waitForReading().
+#ifndef _TLA2024_H_
+#define _TLA2024_H_
+
+#include "hal/i2c.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TLA2024_NUM_CHANNELS 4
+
+typedef struct {
+    uint16_t code;     // Right-aligned 12-bit conversion result
+    uint32_t sequence; // Counts conversions on this channel; 0 until the first
+} Tla2024_reading_t;
+
+// Start scanning `channel` (0 to 3) at least `scans_per_second` times a
+// second. The most demanding open channel sets the rate of the whole scan.
+// The first open channel opens the bus and starts the scan thread.
+// Returns false if the ADC could not be opened.
+bool Tla2024_openChannel(int channel, int scans_per_second);
+
+// Stop scanning `channel`; the last close stops the thread and closes the bus.
+void Tla2024_closeChannel(int channel);
+
+// Get the latest conversion of an open channel. Never blocks.
+Tla2024_reading_t Tla2024_read(int channel);
+
+// Wait up to `timeout_ns` for a conversion of `channel` newer than
+// `after_sequence`, and return the latest conversion. If none arrives in
+// time, returns the same (stale) reading as Tla2024_read().
+Tla2024_reading_t Tla2024_waitForReading(int channel, uint32_t after_sequence,
+                                         long long timeout_ns);
+
+// Get the counters of the ADC's I2C bus (see I2c_getStats()). All zero
+// while no channel is open.
+void Tla2024_getI2cStats(I2c_stats_t *pStats);
+
+#endif
@@ -5,13 +5,27 @@
 
 // Module that implements a UDP server for remote command control of the application.
 // Runs a background thread that listens on a UDP socket (port 12345) for incoming commands.
+// The thread waits in epoll, receives and replies in batches (recvmmsg/sendmmsg)
+// and keeps a session per client address, so any number of clients can talk
+// to it at once. UdpServer_cleanup() wakes it through an eventfd.
 // Supports the following commands:
 // - help/?: Show help message with available commands
 // - count: Get total number of samples taken
 // - length: Get number of samples taken in the previous second
 // - dips: Get number of light dips detected in the previous second
 // - history: Get all voltage samples from the previous second
-// - <enter>: Repeat the last command
+// - history binary: Same samples as packed int16 millivolts, in as few
+//   datagrams as fit (format in hal/history_packet.h)
+// - trend <second|minute|hour> [N]: Get min/max/mean light level for the
+//   last N completed seconds, minutes or hours
+// - range <start> <count>: Get retained samples by absolute index (minutes
+//   of them), as paged datagrams a client can re-request individually.
+//   Plain "range" reports which indices are retained.
+// - subscribe <summary|history|dips>: Push a statistics line or the binary
+//   history every second, or a line as dips start. Subscriptions lapse if the
+//   client sends nothing for 30 s.
+// - unsubscribe [summary|history|dips]: Stop pushes (all of them if none named)
+// - <enter>: Repeat the last command (from the same client)
 // - stop: Exit the program
 // Provides error responses for unknown commands.
 
@@ -0,0 +1,169 @@
+// Shared I2C buses with combined-transaction register access.
+
+#include "hal/i2c.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#define MAX_BUSES 4
+#define MAX_PATH_LENGTH 32
+
+struct I2c_bus {
+    char path[MAX_PATH_LENGTH];
+    int file_desc;
+    int num_opens;
+    atomic_llong transactions;
+    atomic_llong bytes_written;
+    atomic_llong bytes_read;
+    atomic_llong errors;
+};
+
+// Buses are opened and closed under buses_lock; transfers need no lock,
+// since each is a single system call.
+static pthread_mutex_t buses_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct I2c_bus buses[MAX_BUSES];
+
+I2c_bus_t *I2c_openBus(const char *path)
+{
+    assert(strlen(path) < MAX_PATH_LENGTH);
+
+    pthread_mutex_lock(&buses_lock);
+    I2c_bus_t *pFree = NULL;
+    for (int i = 0; i < MAX_BUSES; i++)
+    {
+        I2c_bus_t *pBus = &buses[i];
+        if (pBus->num_opens > 0 && strcmp(pBus->path, path) == 0)
+        {
+            pBus->num_opens++;
+            pthread_mutex_unlock(&buses_lock);
+            return pBus;
+        }
+        if (pBus->num_opens == 0 && !pFree)
+        {
+            pFree = pBus;
+        }
+    }
+
+    if (!pFree)
+    {
+        printf("I2C DRV: Too many buses open\n");
+        pthread_mutex_unlock(&buses_lock);
+        return NULL;
+    }
+
+    int file_desc = open(path, O_RDWR);
+    if (file_desc == -1)
+    {
+        printf("I2C DRV: Unable to open bus for read/write (%s)\n", path);
+        perror("Error is:");
+        pthread_mutex_unlock(&buses_lock);
+        return NULL;
+    }
+
+    strcpy(pFree->path, path);
+    pFree->file_desc = file_desc;
+    pFree->num_opens = 1;
+    atomic_store(&pFree->transactions, 0);
+    atomic_store(&pFree->bytes_written, 0);
+    atomic_store(&pFree->bytes_read, 0);
+    atomic_store(&pFree->errors, 0);
+    pthread_mutex_unlock(&buses_lock);
+    return pFree;
+}
+
+void I2c_closeBus(I2c_bus_t *pBus)
+{
+    pthread_mutex_lock(&buses_lock);
+    assert(pBus->num_opens > 0);
+    if (--pBus->num_opens == 0)
+    {
+        close(pBus->file_desc);
+        pBus->file_desc = -1;
+    }
+    pthread_mutex_unlock(&buses_lock);
+}
+
+// Issue the messages as one transaction and count it
+static bool transfer(I2c_bus_t *pBus, struct i2c_msg *pMessages, int num_messages)
+{
+    struct i2c_rdwr_ioctl_data transaction = {
+        .msgs = pMessages,
+        .nmsgs = num_messages,
+    };
+
+    atomic_fetch_add_explicit(&pBus->transactions, 1, memory_order_relaxed);
+    if (ioctl(pBus->file_desc, I2C_RDWR, &transaction) != num_messages)
+    {
+        atomic_fetch_add_explicit(&pBus->errors, 1, memory_order_relaxed);
+        return false;
+    }
+
+    for (int i = 0; i < num_messages; i++)
+    {
+        atomic_llong *pCounter = (pMessages[i].flags & I2C_M_RD) ? &pBus->bytes_read
+                                                                 : &pBus->bytes_written;
+        atomic_fetch_add_explicit(pCounter, pMessages[i].len, memory_order_relaxed);
+    }
+    return true;
+}
+
+bool I2c_writeReg8(I2c_bus_t *pBus, uint8_t address, uint8_t reg, uint8_t value)
+{
+    uint8_t buff[2] = {reg, value};
+    struct i2c_msg message = {
+        .addr = address,
+        .flags = 0,
+        .len = sizeof(buff),
+        .buf = buff,
+    };
+    return transfer(pBus, &message, 1);
+}
+
+bool I2c_writeReg16(I2c_bus_t *pBus, uint8_t address, uint8_t reg, uint16_t value)
+{
+    uint8_t buff[3] = {reg, value & 0xFF, (value & 0xFF00) >> 8};
+    struct i2c_msg message = {
+        .addr = address,
+        .flags = 0,
+        .len = sizeof(buff),
+        .buf = buff,
+    };
+    return transfer(pBus, &message, 1);
+}
+
+bool I2c_readRegs(I2c_bus_t *pBus, uint8_t address, uint8_t reg,
+                  uint8_t *pData, size_t length)
+{
+    // Register address write, then a repeated start into the read
+    struct i2c_msg messages[2] = {
+        {.addr = address, .flags = 0, .len = 1, .buf = &reg},
+        {.addr = address, .flags = I2C_M_RD, .len = length, .buf = pData},
+    };
+    return transfer(pBus, messages, 2);
+}
+
+bool I2c_readReg16(I2c_bus_t *pBus, uint8_t address, uint8_t reg, uint16_t *pValue)
+{
+    uint8_t buff[2];
+    if (!I2c_readRegs(pBus, address, reg, buff, sizeof(buff)))
+    {
+        return false;
+    }
+    memcpy(pValue, buff, sizeof(buff));
+    return true;
+}
+
+void I2c_getStats(I2c_bus_t *pBus, I2c_stats_t *pStats)
+{
+    pStats->transactions = atomic_load_explicit(&pBus->transactions, memory_order_relaxed);
+    pStats->bytes_written = atomic_load_explicit(&pBus->bytes_written, memory_order_relaxed);
+    pStats->bytes_read = atomic_load_explicit(&pBus->bytes_read, memory_order_relaxed);
+    pStats->errors = atomic_load_explicit(&pBus->errors, memory_order_relaxed);
+}
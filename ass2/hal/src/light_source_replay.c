@@ -0,0 +1,111 @@
+// Light source that replays a SampleRecorder recording.
+// The codes are loaded into memory at open so reads never touch the disk;
+// playback loops back to the start when it reaches the end.
+
+#include "hal/light_source.h"
+#include "hal/sample_recorder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *replay_path = NULL;
+static uint16_t *codes = NULL;
+static uint64_t num_codes = 0;
+static uint64_t next_code = 0;
+
+void LightSource_configureReplay(const char *path)
+{
+    replay_path = path;
+}
+
+// Load the recorded codes, oldest first. Exits on any error.
+static void load_recording(FILE *pFile)
+{
+    SampleRecorder_header_t header;
+    if (fread(&header, sizeof(header), 1, pFile) != 1 ||
+        memcmp(header.magic, SAMPLE_RECORDER_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != SAMPLE_RECORDER_VERSION ||
+        header.record_size != sizeof(SampleRecorder_record_t))
+    {
+        printf("Replay: %s is not a usable sample recording\n", replay_path);
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t written = atomic_load(&header.num_written);
+    num_codes = (written > header.capacity) ? header.capacity : written;
+    uint64_t first_slot = (written > header.capacity) ? written % header.capacity : 0;
+    if (num_codes == 0)
+    {
+        printf("Replay: %s has no samples\n", replay_path);
+        exit(EXIT_FAILURE);
+    }
+
+    codes = malloc(num_codes * sizeof(uint16_t));
+    if (!codes)
+    {
+        perror("Replay: unable to allocate samples");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint64_t i = 0; i < num_codes; i++)
+    {
+        uint64_t slot = (first_slot + i) % header.capacity;
+        if (i == 0 || slot == 0)
+        {
+            fseek(pFile, sizeof(header) + slot * sizeof(SampleRecorder_record_t), SEEK_SET);
+        }
+
+        SampleRecorder_record_t record;
+        if (fread(&record, sizeof(record), 1, pFile) != 1)
+        {
+            printf("Replay: %s is truncated\n", replay_path);
+            exit(EXIT_FAILURE);
+        }
+        codes[i] = record.code;
+    }
+}
+
+static void replay_open(int samples_per_second)
+{
+    if (!replay_path)
+    {
+        printf("Replay: no recording configured\n");
+        exit(EXIT_FAILURE);
+    }
+
+    FILE *pFile = fopen(replay_path, "rb");
+    if (!pFile)
+    {
+        perror("Replay: unable to open recording");
+        exit(EXIT_FAILURE);
+    }
+    load_recording(pFile);
+    fclose(pFile);
+
+    next_code = 0;
+    printf("Replay: %llu samples from %s at %d samples/s\n",
+           (unsigned long long)num_codes, replay_path, samples_per_second);
+}
+
+static uint16_t replay_read(long long timestamp_ns)
+{
+    (void)timestamp_ns;
+
+    uint16_t code = codes[next_code];
+    next_code = (next_code + 1) % num_codes;
+    return code;
+}
+
+static void replay_close(void)
+{
+    free(codes);
+    codes = NULL;
+    num_codes = 0;
+}
+
+const LightSource_t LightSource_replay = {
+    .name = "replay",
+    .open = replay_open,
+    .read = replay_read,
+    .close = replay_close,
+};
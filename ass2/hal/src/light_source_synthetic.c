@@ -0,0 +1,85 @@
+// Synthetic light source for running the Sampler without hardware.
+// Produces a steady level with square-wave dips and uniform noise,
+// computed from the sample timestamp so it is repeatable at any speed.
+
+#include "hal/light_source.h"
+#include "hal/sampler.h"
+#include <stdio.h>
+
+#define NS_PER_SECOND 1000000000LL
+
+// Waveform shape
+#define BASE_VOLTS 1.5
+#define DIP_DEPTH_VOLTS 0.5
+#define DIP_DUTY 0.2 // Fraction of each cycle spent dipped
+#define MAX_CODE 4095
+
+static double dip_hz = 10.0;
+static double noise_volts = 0.01;
+
+static double volts_per_code = 0.0;
+static uint32_t noise_state = 1;
+
+void LightSource_configureSynthetic(double new_dip_hz, double new_noise_volts)
+{
+    dip_hz = new_dip_hz;
+    noise_volts = new_noise_volts;
+}
+
+// xorshift32: cheap, repeatable noise
+static uint32_t next_noise(void)
+{
+    noise_state ^= noise_state << 13;
+    noise_state ^= noise_state >> 17;
+    noise_state ^= noise_state << 5;
+    return noise_state;
+}
+
+static void synthetic_open(int samples_per_second)
+{
+    printf("Synthetic light source: %.1f Hz dips, +/-%.3f V noise (%d samples/s)\n",
+           dip_hz, noise_volts, samples_per_second);
+    volts_per_code = Sampler_codeToVoltage(1);
+    noise_state = 1;
+}
+
+static uint16_t synthetic_read(long long timestamp_ns)
+{
+    double volts = BASE_VOLTS;
+
+    if (dip_hz > 0)
+    {
+        // Position within the current dip cycle, from 0 to 1
+        long long cycle_ns = (long long)(NS_PER_SECOND / dip_hz);
+        double phase = (double)(timestamp_ns % cycle_ns) / cycle_ns;
+        if (phase < DIP_DUTY)
+        {
+            volts -= DIP_DEPTH_VOLTS;
+        }
+    }
+
+    // Uniform in [-noise_volts, noise_volts]
+    volts += noise_volts * ((next_noise() / (double)UINT32_MAX) * 2.0 - 1.0);
+
+    long code = (long)(volts / volts_per_code + 0.5);
+    if (code < 0)
+    {
+        code = 0;
+    }
+    if (code > MAX_CODE)
+    {
+        code = MAX_CODE;
+    }
+    return (uint16_t)code;
+}
+
+static void synthetic_close(void)
+{
+}
+
+const LightSource_t LightSource_synthetic = {
+    .name = "synthetic",
+    .open = synthetic_open,
+    .read = synthetic_read,
+    .close = synthetic_close,
+};
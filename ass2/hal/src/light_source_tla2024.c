@@ -0,0 +1,85 @@
+// Light source backed by the Zen Hat's light sensor on channel 2 of the
+// TLA2024 ADC. The ADC is shared through the Tla2024 module, which scans
+// the channel at the sampling rate on its own clock. Each read waits (up
+// to one scan period) for a conversion it has not returned yet, so the
+// Sampler gets every conversion once; misses are counted.
+
+#include "hal/light_source.h"
+#include "hal/tla2024.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define LIGHT_SENSOR_CHANNEL 2
+#define FIRST_READING_POLL_US 1000
+#define FIRST_READING_TIMEOUT_POLLS 100
+#define NS_PER_SECOND 1000000000LL
+
+// Read state; only used by the sampling thread (stats are read by others)
+static long long scan_period_ns = 0;
+static uint32_t last_sequence = 0;
+static atomic_llong stale_reads = 0;
+static atomic_llong skipped_readings = 0;
+
+static void tla2024_open(int samples_per_second)
+{
+    if (!Tla2024_openChannel(LIGHT_SENSOR_CHANNEL, samples_per_second))
+    {
+        printf("Light sensor: unable to open the ADC\n");
+        exit(EXIT_FAILURE);
+    }
+
+    scan_period_ns = NS_PER_SECOND / samples_per_second;
+    atomic_store(&stale_reads, 0);
+    atomic_store(&skipped_readings, 0);
+
+    // Don't start the Sampler's average from an empty slot
+    for (int i = 0; i < FIRST_READING_TIMEOUT_POLLS; i++)
+    {
+        last_sequence = Tla2024_read(LIGHT_SENSOR_CHANNEL).sequence;
+        if (last_sequence != 0)
+        {
+            return;
+        }
+        usleep(FIRST_READING_POLL_US);
+    }
+    printf("Light sensor: no reading from the ADC yet\n");
+}
+
+static uint16_t tla2024_read(long long timestamp_ns)
+{
+    (void)timestamp_ns;
+    Tla2024_reading_t reading = Tla2024_waitForReading(LIGHT_SENSOR_CHANNEL, last_sequence,
+                                                       scan_period_ns);
+    uint32_t new_readings = reading.sequence - last_sequence;
+    if (new_readings == 0)
+    {
+        atomic_fetch_add_explicit(&stale_reads, 1, memory_order_relaxed);
+    }
+    else if (new_readings > 1)
+    {
+        atomic_fetch_add_explicit(&skipped_readings, new_readings - 1, memory_order_relaxed);
+    }
+    last_sequence = reading.sequence;
+    return reading.code;
+}
+
+static void tla2024_get_stats(LightSource_stats_t *pStats)
+{
+    pStats->stale_reads = atomic_load_explicit(&stale_reads, memory_order_relaxed);
+    pStats->skipped_readings = atomic_load_explicit(&skipped_readings, memory_order_relaxed);
+}
+
+static void tla2024_close(void)
+{
+    Tla2024_closeChannel(LIGHT_SENSOR_CHANNEL);
+}
+
+const LightSource_t LightSource_tla2024 = {
+    .name = "tla2024",
+    .open = tla2024_open,
+    .read = tla2024_read,
+    .close = tla2024_close,
+    .get_stats = tla2024_get_stats,
+};
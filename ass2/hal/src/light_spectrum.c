@@ -0,0 +1,236 @@
+// Radix-2 FFT peak finder for windows of light samples.
+// Data is kept as separate real/imaginary float arrays and each stage's
+// twiddles are stored contiguously, so the butterfly loops are unit-stride
+// and vectorize (NEON on the board).
+
+#include "hal/light_spectrum.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MIN_WINDOW 8
+
+static int max_fft_size = 0;
+
+// Twiddles for the stage with half-size h live at [h - 1, 2h - 1):
+// exp(-i * pi * k / h) for k < h. Every stage up to max_fft_size fits
+// in max_fft_size - 1 entries.
+static float *twiddle_re = NULL;
+static float *twiddle_im = NULL;
+
+// Work buffers
+static float *data_re = NULL;
+static float *data_im = NULL;
+
+// Hann window and bit-reversal order, rebuilt only when the size changes
+static float *window = NULL;
+static float window_sum = 0;
+static int window_size = 0;
+static int *bit_reverse = NULL;
+static int bit_reverse_size = 0;
+
+static int next_power_of_two(int n)
+{
+    int power = 1;
+    while (power < n)
+    {
+        power <<= 1;
+    }
+    return power;
+}
+
+static void *alloc_or_exit(size_t size)
+{
+    void *p = malloc(size);
+    if (!p)
+    {
+        perror("Light spectrum: unable to allocate buffers");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+void LightSpectrum_init(int max_samples)
+{
+    assert(max_samples > 0);
+    max_fft_size = next_power_of_two(max_samples);
+
+    twiddle_re = alloc_or_exit(max_fft_size * sizeof(float));
+    twiddle_im = alloc_or_exit(max_fft_size * sizeof(float));
+    for (int h = 1; h < max_fft_size; h <<= 1)
+    {
+        for (int k = 0; k < h; k++)
+        {
+            double angle = -M_PI * k / h;
+            twiddle_re[h - 1 + k] = (float)cos(angle);
+            twiddle_im[h - 1 + k] = (float)sin(angle);
+        }
+    }
+
+    data_re = alloc_or_exit(max_fft_size * sizeof(float));
+    data_im = alloc_or_exit(max_fft_size * sizeof(float));
+    window = alloc_or_exit(max_samples * sizeof(float));
+    bit_reverse = alloc_or_exit(max_fft_size * sizeof(int));
+    window_size = 0;
+    bit_reverse_size = 0;
+}
+
+void LightSpectrum_cleanup(void)
+{
+    free(twiddle_re);
+    free(twiddle_im);
+    free(data_re);
+    free(data_im);
+    free(window);
+    free(bit_reverse);
+    twiddle_re = twiddle_im = data_re = data_im = window = NULL;
+    bit_reverse = NULL;
+    max_fft_size = 0;
+}
+
+static void prepare_window(int size)
+{
+    if (size == window_size)
+    {
+        return;
+    }
+
+    window_sum = 0;
+    for (int i = 0; i < size; i++)
+    {
+        window[i] = (float)(0.5 - 0.5 * cos(2 * M_PI * i / (size - 1)));
+        window_sum += window[i];
+    }
+    window_size = size;
+}
+
+static void prepare_bit_reverse(int n)
+{
+    if (n == bit_reverse_size)
+    {
+        return;
+    }
+
+    int bits = 0;
+    while ((1 << bits) < n)
+    {
+        bits++;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        int reversed = 0;
+        for (int b = 0; b < bits; b++)
+        {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bit_reverse[i] = reversed;
+    }
+    bit_reverse_size = n;
+}
+
+// In-place iterative radix-2 decimation-in-time FFT on data_re/data_im
+static void fft(int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        int j = bit_reverse[i];
+        if (i < j)
+        {
+            float tmp = data_re[i];
+            data_re[i] = data_re[j];
+            data_re[j] = tmp;
+            tmp = data_im[i];
+            data_im[i] = data_im[j];
+            data_im[j] = tmp;
+        }
+    }
+
+    for (int h = 1; h < n; h <<= 1)
+    {
+        const float *restrict w_re = twiddle_re + h - 1;
+        const float *restrict w_im = twiddle_im + h - 1;
+        for (int start = 0; start < n; start += 2 * h)
+        {
+            float *restrict a_re = data_re + start;
+            float *restrict a_im = data_im + start;
+            float *restrict b_re = data_re + start + h;
+            float *restrict b_im = data_im + start + h;
+            for (int k = 0; k < h; k++)
+            {
+                float t_re = w_re[k] * b_re[k] - w_im[k] * b_im[k];
+                float t_im = w_re[k] * b_im[k] + w_im[k] * b_re[k];
+                b_re[k] = a_re[k] - t_re;
+                b_im[k] = a_im[k] - t_im;
+                a_re[k] += t_re;
+                a_im[k] += t_im;
+            }
+        }
+    }
+}
+
+void LightSpectrum_findPeak(const uint16_t *codes, int size, int sample_rate_hz,
+                            LightSpectrum_peak_t *pPeak)
+{
+    pPeak->dominant_hz = 0;
+    pPeak->magnitude = 0;
+    pPeak->fft_size = 0;
+    if (size < MIN_WINDOW)
+    {
+        return;
+    }
+    assert(next_power_of_two(size) <= max_fft_size);
+
+    int n = next_power_of_two(size);
+    prepare_window(size);
+    prepare_bit_reverse(n);
+
+    // Remove the DC level so it does not leak into the low bins
+    uint32_t sum = 0;
+    for (int i = 0; i < size; i++)
+    {
+        sum += codes[i];
+    }
+    float mean = (float)sum / size;
+
+    for (int i = 0; i < size; i++)
+    {
+        data_re[i] = (codes[i] - mean) * window[i];
+        data_im[i] = 0;
+    }
+    for (int i = size; i < n; i++)
+    {
+        data_re[i] = 0;
+        data_im[i] = 0;
+    }
+
+    fft(n);
+
+    // Strongest bin between DC and Nyquist (compare squared magnitudes)
+    int peak = 0;
+    float peak_power = 0;
+    for (int k = 1; k < n / 2; k++)
+    {
+        float power = data_re[k] * data_re[k] + data_im[k] * data_im[k];
+        if (power > peak_power)
+        {
+            peak_power = power;
+            peak = k;
+        }
+    }
+    if (peak == 0)
+    {
+        return;
+    }
+
+    // Refine between bins with a parabola through the neighbouring magnitudes
+    double left = hypot(data_re[peak - 1], data_im[peak - 1]);
+    double centre = sqrt(peak_power);
+    double right = hypot(data_re[peak + 1], data_im[peak + 1]);
+    double denominator = left - 2 * centre + right;
+    double offset = (denominator != 0) ? 0.5 * (left - right) / denominator : 0;
+
+    pPeak->dominant_hz = (peak + offset) * sample_rate_hz / n;
+    pPeak->magnitude = 2 * centre / window_sum;
+    pPeak->fft_size = n;
+}
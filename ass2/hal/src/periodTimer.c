@@ -1,39 +1,104 @@
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
-#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
 #include "hal/periodTimer.h"
+#include "hal/cycle_clock.h"
 
 // Written by Brian Fraser
 
 // Data collected
+// Instead of storing every timestamp, each mark files the period since the
+// previous mark into a log-linear (HDR style) histogram: periods below
+// SUB_BUCKETS ticks get a bucket each, and every power of two above that is
+// split into SUB_BUCKETS equal buckets, so any period is known to within
+// 1/SUB_BUCKETS (about 3%) in fixed memory.
+// Periods are in CycleClock ticks, converted to time only when reported.
+// Marking is lock-free: the histogram and totals are cumulative atomic
+// counters that are never cleared. Each reader keeps its own copy of the
+// counters as of its last read (its cursor) and reports the difference,
+// so readers never disturb each other.
+// The histogram only bounds the extremes, so each mark also stores its
+// period into a shared ring of the most recent RECENT_PERIODS periods, at
+// the slot given by its index in totalCount. A reader scans its window's
+// slots for the exact min and max. Marking costs the same whatever the
+// number of readers.
+#define SUB_BUCKET_BITS 5
+#define SUB_BUCKETS (1 << SUB_BUCKET_BITS)
+#define MAX_PERIOD_BITS 36 // 2^36 ticks: 23 s at 3 GHz, 47 min at 24 MHz; longer
+                           // periods land in the top bucket
+#define NUM_BUCKETS ((MAX_PERIOD_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS)
+
+// Ring slots hold (tag << MAX_PERIOD_BITS) | periodTicks, where the tag is
+// the low bits of (mark index + 1): a reader can tell a slot holding its
+// period from one not written yet or already overwritten.
+#define RECENT_PERIODS 4096 // Power of two; a window of more periods uses bucket edges
+#define PERIOD_MASK ((1ULL << MAX_PERIOD_BITS) - 1)
+#define TAG_MASK ((1ULL << (64 - MAX_PERIOD_BITS)) - 1)
+
 typedef struct
 {
-    // Store the timestamp samples each time we mark an event.
-    long timestampCount;
-    long long timestampsInNs[MAX_EVENT_TIMESTAMPS];
+    // Updated by Period_markEvent()
+    atomic_ullong prevTimestamp; // CycleClock ticks
+    atomic_uint bucketCounts[NUM_BUCKETS];
+    atomic_ullong totalCount;
+    atomic_ullong totalPeriodTicks;
+    atomic_ullong totalAboveThreshold;
+    atomic_llong thresholdTicks;
+    atomic_ullong recentPeriods[RECENT_PERIODS];
+} periods_t;
+static periods_t s_eventData[NUM_PERIOD_EVENTS];
 
-    // Used for recording the event between analysis periods.
-    long long prevTimestampInNs;
-} timestamps_t;
-static timestamps_t s_eventData[NUM_PERIOD_EVENTS];
+// A reader's cursor: the event's counters as of its last read
+struct Period_reader
+{
+    enum Period_whichEvent whichEvent;
+    unsigned int bucketCounts[NUM_BUCKETS];
+    unsigned long long totalCount;
+    unsigned long long totalPeriodTicks;
+    unsigned long long totalAboveThreshold;
+};
 
-static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
 static bool s_initialized = false;
 
 // Prototypes
+static int bucketForPeriod(long long periodTicks);
+static long long bucketLowestTicks(int bucket);
+static long long bucketHighestTicks(int bucket);
+static double bucketMidpointTicks(int bucket);
+static bool recentExtremes(periods_t *pData, unsigned long long first,
+                           unsigned long long end, long long *pMinTicks,
+                           long long *pMaxTicks);
 static void updateStats(
-    timestamps_t *pData,
+    Period_reader_t *pReader,
     Period_statistics_t *pStats);
-static long long getTimeInNanoS(void);
+static double percentileTicks(const unsigned int *counts, unsigned long long total,
+                           double fraction);
 
 void Period_init(void)
 {
-    memset(s_eventData, 0, sizeof(s_eventData[0]) * NUM_PERIOD_EVENTS);
+    CycleClock_init();
+    for (int i = 0; i < NUM_PERIOD_EVENTS; i++)
+    {
+        periods_t *pData = &s_eventData[i];
+        atomic_store(&pData->prevTimestamp, 0);
+        for (int j = 0; j < NUM_BUCKETS; j++)
+        {
+            atomic_store(&pData->bucketCounts[j], 0);
+        }
+        atomic_store(&pData->totalCount, 0);
+        atomic_store(&pData->totalPeriodTicks, 0);
+        atomic_store(&pData->totalAboveThreshold, 0);
+        atomic_store(&pData->thresholdTicks, 0);
+        for (int j = 0; j < RECENT_PERIODS; j++)
+        {
+            atomic_store(&pData->recentPeriods[j], 0);
+        }
+    }
     s_initialized = true;
 }
 
@@ -43,111 +108,227 @@ void Period_cleanup(void)
     s_initialized = false;
 }
 
+void Period_setThreshold(enum Period_whichEvent whichEvent, double thresholdInMs)
+{
+    assert(whichEvent >= 0 && whichEvent < NUM_PERIOD_EVENTS);
+    assert(s_initialized);
+    long long thresholdTicks = (long long)(thresholdInMs * 1000 * 1000 / CycleClock_nsPerTick());
+    atomic_store(&s_eventData[whichEvent].thresholdTicks, thresholdTicks);
+}
+
 void Period_markEvent(enum Period_whichEvent whichEvent)
 {
     assert(whichEvent >= 0 && whichEvent < NUM_PERIOD_EVENTS);
     assert(s_initialized);
 
-    timestamps_t *pData = &s_eventData[whichEvent];
-    pthread_mutex_lock(&s_lock);
+    periods_t *pData = &s_eventData[whichEvent];
+    uint64_t now = CycleClock_now();
+    uint64_t prev = atomic_exchange_explicit(&pData->prevTimestamp, now,
+                                             memory_order_relaxed);
+    if (prev == 0)
     {
-        if (pData->timestampCount < MAX_EVENT_TIMESTAMPS)
-        {
-            pData->timestampsInNs[pData->timestampCount] = getTimeInNanoS();
-            pData->timestampCount++;
-        }
-        else
-        {
-            printf("WARNING: No sample space for event collection on %d\n", whichEvent);
-        }
+        return; // First mark: no period yet
+    }
+    long long periodTicks = (now > prev) ? (long long)(now - prev) : 0;
+
+    atomic_fetch_add_explicit(&pData->bucketCounts[bucketForPeriod(periodTicks)], 1,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&pData->totalPeriodTicks, periodTicks, memory_order_relaxed);
+    unsigned long long index = atomic_fetch_add_explicit(&pData->totalCount, 1,
+                                                         memory_order_relaxed);
+    unsigned long long storedTicks = ((unsigned long long)periodTicks < PERIOD_MASK)
+                                         ? (unsigned long long)periodTicks
+                                         : PERIOD_MASK;
+    atomic_store_explicit(&pData->recentPeriods[index & (RECENT_PERIODS - 1)],
+                          (((index + 1) & TAG_MASK) << MAX_PERIOD_BITS) | storedTicks,
+                          memory_order_release);
+
+    long long thresholdTicks = atomic_load_explicit(&pData->thresholdTicks, memory_order_relaxed);
+    if (thresholdTicks > 0 && periodTicks > thresholdTicks)
+    {
+        atomic_fetch_add_explicit(&pData->totalAboveThreshold, 1, memory_order_relaxed);
     }
-    pthread_mutex_unlock(&s_lock);
 }
 
-void Period_getStatisticsAndClear(
-    enum Period_whichEvent whichEvent,
-    Period_statistics_t *pStats)
+Period_reader_t *Period_openReader(enum Period_whichEvent whichEvent)
 {
     assert(whichEvent >= 0 && whichEvent < NUM_PERIOD_EVENTS);
     assert(s_initialized);
-    timestamps_t *pData = &s_eventData[whichEvent];
-    pthread_mutex_lock(&s_lock);
+
+    Period_reader_t *pReader = malloc(sizeof(*pReader));
+    if (!pReader)
     {
-        // Compute stats
-        updateStats(pData, pStats);
+        perror("Unable to allocate period reader");
+        exit(EXIT_FAILURE);
+    }
+    pReader->whichEvent = whichEvent;
 
-        // Update the "previous" sample (if we have any)
-        if (pData->timestampCount > 0)
-        {
-            pData->prevTimestampInNs = pData->timestampsInNs[pData->timestampCount - 1];
-        }
+    // Start the first window now, by reading and discarding what came before
+    Period_statistics_t unused;
+    memset(pReader->bucketCounts, 0, sizeof(pReader->bucketCounts));
+    pReader->totalCount = 0;
+    pReader->totalPeriodTicks = 0;
+    pReader->totalAboveThreshold = 0;
+    updateStats(pReader, &unused);
+    return pReader;
+}
 
-        // Clear
-        pData->timestampCount = 0;
-    }
-    pthread_mutex_unlock(&s_lock);
+void Period_closeReader(Period_reader_t *pReader)
+{
+    free(pReader);
 }
 
-static void updateStats(
-    timestamps_t *pData,
-    Period_statistics_t *pStats)
+void Period_getStatistics(Period_reader_t *pReader, Period_statistics_t *pStats)
 {
-    long long prevInNs = pData->prevTimestampInNs;
+    assert(pReader);
+    assert(s_initialized);
+    updateStats(pReader, pStats);
+}
 
-    // Handle startup (no previous sample)
-    if (prevInNs == 0)
+// Bucket index for a period: linear below SUB_BUCKETS ticks, then SUB_BUCKETS
+// buckets per power of two.
+static int bucketForPeriod(long long periodTicks)
+{
+    if (periodTicks < SUB_BUCKETS)
     {
-        prevInNs = pData->timestampsInNs[0];
+        return (int)periodTicks;
     }
+    int topBit = 63 - __builtin_clzll((unsigned long long)periodTicks);
+    int shift = topBit - SUB_BUCKET_BITS;
+    int bucket = (shift + 1) * SUB_BUCKETS + (int)((periodTicks >> shift) - SUB_BUCKETS);
+    return (bucket < NUM_BUCKETS) ? bucket : NUM_BUCKETS - 1;
+}
 
-    // Find min/max/sum time delta between consecutive samples
-    long long sumDeltasNs = 0;
-    long long minNs = 0;
-    long long maxNs = 0;
-    for (int i = 0; i < pData->timestampCount; i++)
+static long long bucketLowestTicks(int bucket)
+{
+    int group = bucket / SUB_BUCKETS;
+    int subBucket = bucket % SUB_BUCKETS;
+    if (group == 0)
     {
-        long long thisTime = pData->timestampsInNs[i];
-        long long deltaNs = thisTime - prevInNs;
-        sumDeltasNs += deltaNs;
+        return subBucket;
+    }
+    return (long long)(SUB_BUCKETS + subBucket) << (group - 1);
+}
 
-        if (i == 0 || deltaNs < minNs)
+static long long bucketHighestTicks(int bucket)
+{
+    int group = bucket / SUB_BUCKETS;
+    long long width = (group == 0) ? 1 : 1LL << (group - 1);
+    return bucketLowestTicks(bucket) + width - 1;
+}
+
+static double bucketMidpointTicks(int bucket)
+{
+    return (bucketLowestTicks(bucket) + bucketHighestTicks(bucket)) / 2.0;
+}
+
+// Exact min and max of the periods with mark indices [first, end), from
+// the ring. False if any of them is no longer (or not yet) in the ring.
+static bool recentExtremes(periods_t *pData, unsigned long long first,
+                           unsigned long long end, long long *pMinTicks,
+                           long long *pMaxTicks)
+{
+    if (end <= first || end - first > RECENT_PERIODS)
+    {
+        return false;
+    }
+    unsigned long long minTicks = PERIOD_MASK;
+    unsigned long long maxTicks = 0;
+    for (unsigned long long index = first; index < end; index++)
+    {
+        unsigned long long entry = atomic_load_explicit(
+            &pData->recentPeriods[index & (RECENT_PERIODS - 1)], memory_order_acquire);
+        if ((entry >> MAX_PERIOD_BITS) != ((index + 1) & TAG_MASK))
         {
-            minNs = deltaNs;
+            return false;
         }
-        if (i == 0 || deltaNs > maxNs)
+        unsigned long long ticks = entry & PERIOD_MASK;
+        minTicks = (ticks < minTicks) ? ticks : minTicks;
+        maxTicks = (ticks > maxTicks) ? ticks : maxTicks;
+    }
+    *pMinTicks = (long long)minTicks;
+    *pMaxTicks = (long long)maxTicks;
+    return true;
+}
+
+// Fill in the statistics for the periods marked since the reader's last
+// read, and move its cursor up to now.
+static void updateStats(
+    Period_reader_t *pReader,
+    Period_statistics_t *pStats)
+{
+    periods_t *pData = &s_eventData[pReader->whichEvent];
+    unsigned int counts[NUM_BUCKETS];
+    unsigned long long numPeriods = 0;
+    int lowestBucket = -1;
+    int highestBucket = -1;
+    for (int i = 0; i < NUM_BUCKETS; i++)
+    {
+        unsigned int now = atomic_load_explicit(&pData->bucketCounts[i], memory_order_relaxed);
+        counts[i] = now - pReader->bucketCounts[i];
+        pReader->bucketCounts[i] = now;
+        numPeriods += counts[i];
+        if (counts[i] > 0)
         {
-            maxNs = deltaNs;
+            lowestBucket = (lowestBucket < 0) ? i : lowestBucket;
+            highestBucket = i;
         }
-
-        prevInNs = thisTime;
     }
 
-    long long avgNs = 0;
-    if (pData->timestampCount > 0)
+    unsigned long long totalCount = atomic_load_explicit(&pData->totalCount, memory_order_relaxed);
+    unsigned long long totalTicks = atomic_load_explicit(&pData->totalPeriodTicks, memory_order_relaxed);
+    unsigned long long totalAbove = atomic_load_explicit(&pData->totalAboveThreshold,
+                                                         memory_order_relaxed);
+    unsigned long long windowStart = pReader->totalCount;
+    unsigned long long count = totalCount - windowStart;
+    unsigned long long sumTicks = totalTicks - pReader->totalPeriodTicks;
+    pStats->numAboveThreshold = (int)(totalAbove - pReader->totalAboveThreshold);
+    pReader->totalCount = totalCount;
+    pReader->totalPeriodTicks = totalTicks;
+    pReader->totalAboveThreshold = totalAbove;
+
+    // Exact min/max from the ring when the whole window is still there;
+    // otherwise (a window of more than RECENT_PERIODS periods, or a mark
+    // still in progress) the edges of the outermost buckets used
+    long long minTicks = 0;
+    long long maxTicks = 0;
+    if (numPeriods > 0 &&
+        !recentExtremes(pData, windowStart, totalCount, &minTicks, &maxTicks))
     {
-        avgNs = sumDeltasNs / pData->timestampCount;
+        minTicks = bucketLowestTicks(lowestBucket);
+        maxTicks = bucketHighestTicks(highestBucket);
     }
 
 // Save stats
 #define MS_PER_NS (1000 * 1000.0)
-    pStats->minPeriodInMs = minNs / MS_PER_NS;
-    pStats->maxPeriodInMs = maxNs / MS_PER_NS;
-    pStats->avgPeriodInMs = avgNs / MS_PER_NS;
-    pStats->numSamples = pData->timestampCount;
+    const double msPerTick = CycleClock_nsPerTick() / MS_PER_NS;
+    pStats->minPeriodInMs = minTicks * msPerTick;
+    pStats->maxPeriodInMs = maxTicks * msPerTick;
+    pStats->avgPeriodInMs = (count > 0) ? (double)sumTicks / count * msPerTick : 0.0;
+    pStats->numSamples = (int)numPeriods;
+    pStats->p50PeriodInMs = percentileTicks(counts, numPeriods, 0.50) * msPerTick;
+    pStats->p90PeriodInMs = percentileTicks(counts, numPeriods, 0.90) * msPerTick;
+    pStats->p99PeriodInMs = percentileTicks(counts, numPeriods, 0.99) * msPerTick;
+    pStats->p999PeriodInMs = percentileTicks(counts, numPeriods, 0.999) * msPerTick;
 }
 
-// Timing function
-static long long getTimeInNanoS(void)
+// The period that `fraction` of the periods are no longer than
+static double percentileTicks(const unsigned int *counts, unsigned long long total,
+                           double fraction)
 {
-    struct timespec spec;
-    clock_gettime(CLOCK_BOOTTIME, &spec);
-    long long seconds = spec.tv_sec;
-    long long nanoSeconds = spec.tv_nsec + seconds * 1000 * 1000 * 1000;
-    assert(nanoSeconds > 0);
-
-    static long long lastTimeHack = 0;
-    assert(nanoSeconds > lastTimeHack);
-    lastTimeHack = nanoSeconds;
-
-    return nanoSeconds;
-}
\ No newline at end of file
+    if (total == 0)
+    {
+        return 0.0;
+    }
+    unsigned long long rank = (unsigned long long)(fraction * total + 0.999999);
+    unsigned long long seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+        {
+            return bucketMidpointTicks(i);
+        }
+    }
+    return bucketMidpointTicks(NUM_BUCKETS - 1);
+}
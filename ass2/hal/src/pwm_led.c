@@ -1,3 +1,12 @@
+// PWM LED driven by an actuator thread.
+// PwmLed_setFrequency() only posts the target into a mailbox and wakes
+// the thread through an eventfd, so callers never wait on sysfs. The
+// thread applies the latest target: requests made while it was writing
+// are coalesced into one update. It remembers what it last wrote, skips
+// writes that would not change anything, and orders the period and duty
+// writes so the duty always fits the period (the kernel rejects a duty
+// longer than the period) without ever first turning the LED off.
+
 #include "hal/pwm_led.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -5,20 +14,40 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
 
 #define PWM_PATH "/dev/hat/pwm/GPIO12"
 #define MAX_PERIOD_NS 469754879
 #define MIN_PERIOD_NS 1000000 // 1ms minimum period (1000Hz max)
+#define MAX_FREQUENCY_HZ 1000.0
+#define MIN_ON_FREQUENCY_HZ 3.0
+#define INITIAL_FREQUENCY_HZ 10.0
+#define UNKNOWN -1 // Value of a PWM file after a failed write
 
 static bool is_initialized = false;
-static double current_frequency = 10.0; // Start at 10Hz
+
+// Mailbox: the latest requested frequency
+static _Atomic double requested_frequency = INITIAL_FREQUENCY_HZ;
 
 // File descriptors for PWM control
 static int fd_enable = -1;
 static int fd_period = -1;
 static int fd_duty = -1;
 
-static void write_pwm_value(int fd, long value)
+// Values last written to the PWM files; only the actuator thread (or
+// init/cleanup while it is not running) touches these
+static long written_period_ns = UNKNOWN;
+static long written_duty_ns = UNKNOWN;
+
+// Actuator thread
+static pthread_t actuator_thread;
+static int wake_fd = -1; // eventfd: posted on each new request and on cleanup
+static volatile bool should_stop = false;
+
+static bool write_pwm_value(int fd, long value)
 {
     // Convert value to string
     char str[32];
@@ -28,27 +57,80 @@ static void write_pwm_value(int fd, long value)
     if (lseek(fd, 0, SEEK_SET) == -1)
     {
         perror("Error seeking in PWM file");
-        return;
+        return false;
     }
 
     // Write the value
     if (write(fd, str, strlen(str)) == -1)
     {
         perror("Error writing to PWM file");
+        return false;
+    }
+    return true;
+}
+
+// Write `value` unless the file already holds it
+static void write_if_changed(int fd, long *pWritten, long value)
+{
+    if (*pWritten == value)
+    {
         return;
     }
+    *pWritten = write_pwm_value(fd, value) ? value : UNKNOWN;
 }
 
-static void set_pwm_values(long period_ns, long duty_ns)
+// Drive the PWM at `freq_hz` with a 50% duty cycle, or off below
+// MIN_ON_FREQUENCY_HZ
+static void apply_frequency(double freq_hz)
 {
-    // Always set duty to 0 first
-    write_pwm_value(fd_duty, 0);
+    // For frequencies below 3Hz, turn off the LED (keeping the period)
+    if (freq_hz < MIN_ON_FREQUENCY_HZ)
+    {
+        write_if_changed(fd_duty, &written_duty_ns, 0);
+        return;
+    }
 
-    // Set new period
-    write_pwm_value(fd_period, period_ns);
+    // Convert frequency to period in nanoseconds, within the valid range
+    long period_ns = 1000000000 / freq_hz;
+    if (period_ns > MAX_PERIOD_NS)
+        period_ns = MAX_PERIOD_NS;
+    if (period_ns < MIN_PERIOD_NS)
+        period_ns = MIN_PERIOD_NS;
+    long duty_ns = period_ns / 2;
 
-    // Set new duty cycle
-    write_pwm_value(fd_duty, duty_ns);
+    if (period_ns < written_period_ns)
+    {
+        // Speeding up: shrink the duty to fit the new period, then the period
+        write_if_changed(fd_duty, &written_duty_ns, duty_ns);
+        write_if_changed(fd_period, &written_period_ns, period_ns);
+    }
+    else
+    {
+        // Slowing down (or period unknown): grow the period, then the duty
+        write_if_changed(fd_period, &written_period_ns, period_ns);
+        write_if_changed(fd_duty, &written_duty_ns, duty_ns);
+    }
+}
+
+static void *actuator_thread_function(void *arg)
+{
+    (void)arg;
+    while (true)
+    {
+        // Reading resets the eventfd, so a burst of requests wakes us once
+        uint64_t num_requests;
+        if (read(wake_fd, &num_requests, sizeof(num_requests)) != sizeof(num_requests))
+        {
+            perror("Error waiting for PWM requests");
+            break;
+        }
+        if (should_stop)
+        {
+            break;
+        }
+        apply_frequency(atomic_load(&requested_frequency));
+    }
+    return NULL;
 }
 
 void PwmLed_init(void)
@@ -73,17 +155,26 @@ void PwmLed_init(void)
         exit(1);
     }
 
-    // Initialize with LED off
-    write_pwm_value(fd_duty, 0);
+    // Initialize with LED off: then any period is valid to write first
+    written_period_ns = UNKNOWN;
+    written_duty_ns = UNKNOWN;
+    write_if_changed(fd_duty, &written_duty_ns, 0);
 
-    // Set initial frequency (10Hz)
-    long period_ns = 100000000;   // 100ms = 10Hz
-    long duty_ns = period_ns / 2; // 50% duty cycle
-    set_pwm_values(period_ns, duty_ns);
-
-    // Enable PWM
+    // Set initial frequency (10Hz) and enable PWM
+    atomic_store(&requested_frequency, INITIAL_FREQUENCY_HZ);
+    apply_frequency(INITIAL_FREQUENCY_HZ);
     write_pwm_value(fd_enable, 1);
 
+    // Start actuator thread
+    wake_fd = eventfd(0, 0);
+    if (wake_fd < 0)
+    {
+        perror("Error creating PWM wake event");
+        exit(1);
+    }
+    should_stop = false;
+    pthread_create(&actuator_thread, NULL, actuator_thread_function, NULL);
+
     is_initialized = true;
 }
 
@@ -93,6 +184,17 @@ void PwmLed_cleanup(void)
 
     if (is_initialized)
     {
+        // Stop actuator thread
+        should_stop = true;
+        uint64_t wake = 1;
+        if (write(wake_fd, &wake, sizeof(wake)) != sizeof(wake))
+        {
+            perror("Error waking PWM actuator");
+        }
+        pthread_join(actuator_thread, NULL);
+        close(wake_fd);
+        wake_fd = -1;
+
         // Disable PWM
         if (fd_enable != -1)
         {
@@ -115,40 +217,24 @@ void PwmLed_setFrequency(double freq_hz)
         return;
 
     // Limit frequency to valid range (0 to 1000Hz)
-    if (freq_hz > 1000)
-        freq_hz = 1000;
+    if (freq_hz > MAX_FREQUENCY_HZ)
+        freq_hz = MAX_FREQUENCY_HZ;
+    if (freq_hz < 0)
+        freq_hz = 0;
 
-    // For frequencies below 3Hz, turn off the LED
-    if (freq_hz < 3.0)
+    // Post the new target; only wake the thread if it changed
+    if (atomic_exchange(&requested_frequency, freq_hz) == freq_hz)
     {
-        // Turn off PWM by setting duty cycle to 0
-        write_pwm_value(fd_duty, 0);
-        current_frequency = freq_hz;
         return;
     }
-
-    // Convert frequency to period in nanoseconds
-    long period_ns = (freq_hz > 0) ? (1000000000 / freq_hz) : MAX_PERIOD_NS;
-
-    // Ensure period is within valid range
-    if (period_ns > MAX_PERIOD_NS)
-        period_ns = MAX_PERIOD_NS;
-    if (period_ns < MIN_PERIOD_NS)
-        period_ns = MIN_PERIOD_NS;
-
-    // Set 50% duty cycle
-    long duty_ns = period_ns / 2;
-
-    // Only update if frequency changed to avoid interruption
-    if (freq_hz != current_frequency)
+    uint64_t wake = 1;
+    if (write(wake_fd, &wake, sizeof(wake)) != sizeof(wake))
     {
-        // Update PWM values
-        set_pwm_values(period_ns, duty_ns);
-        current_frequency = freq_hz;
+        perror("Error waking PWM actuator");
     }
 }
 
 double PwmLed_getFrequency(void)
 {
-    return current_frequency;
-}
\ No newline at end of file
+    return atomic_load(&requested_frequency);
+}
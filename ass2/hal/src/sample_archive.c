@@ -0,0 +1,69 @@
+// Raw sample ring keyed by absolute sample index.
+// Sample n lives in slot n % capacity. The sampling thread writes the slot
+// and then publishes it by advancing the sample count; readers copy and then
+// check that the ring did not wrap onto what they copied, like the
+// SamplePyramid's rings.
+
+#include "hal/sample_archive.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+
+static uint16_t archive_codes[SAMPLE_ARCHIVE_CAPACITY];
+static long long archive_timestamps[SAMPLE_ARCHIVE_CAPACITY];
+
+// Number of samples ever added; the next sample's index
+static atomic_llong num_samples;
+
+void SampleArchive_init(void)
+{
+    atomic_store(&num_samples, 0);
+}
+
+void SampleArchive_addSample(uint16_t code, long long timestamp_ns)
+{
+    long long index = atomic_load_explicit(&num_samples, memory_order_relaxed);
+    archive_codes[index % SAMPLE_ARCHIVE_CAPACITY] = code;
+    archive_timestamps[index % SAMPLE_ARCHIVE_CAPACITY] = timestamp_ns;
+    atomic_store_explicit(&num_samples, index + 1, memory_order_release);
+}
+
+int SampleArchive_read(long long start, uint16_t *codes, long long *timestamps_ns,
+                       int max_samples, Sampler_range_t *pRange)
+{
+    while (true)
+    {
+        long long end = atomic_load_explicit(&num_samples, memory_order_acquire);
+
+        // Leave one slot of headroom for the sample the producer may be writing
+        long long oldest = end - (SAMPLE_ARCHIVE_CAPACITY - 1);
+        if (oldest < 0)
+        {
+            oldest = 0;
+        }
+        long long first = (start < oldest) ? oldest : start;
+        long long available = (first < end) ? end - first : 0;
+        int count = (available < max_samples) ? (int)available : max_samples;
+
+        for (int i = 0; i < count; i++)
+        {
+            long long slot = (first + i) % SAMPLE_ARCHIVE_CAPACITY;
+            codes[i] = archive_codes[slot];
+            if (timestamps_ns)
+            {
+                timestamps_ns[i] = archive_timestamps[slot];
+            }
+        }
+
+        // Valid unless the producer has since started overwriting our oldest slot
+        atomic_thread_fence(memory_order_acquire);
+        long long now = atomic_load_explicit(&num_samples, memory_order_relaxed);
+        if (count == 0 || now < first + SAMPLE_ARCHIVE_CAPACITY)
+        {
+            pRange->first_index = first;
+            pRange->oldest_index = oldest;
+            pRange->end_index = end;
+            return count;
+        }
+    }
+}
@@ -0,0 +1,166 @@
+// Multi-resolution light statistics, updated one sample at a time.
+// Each level is a ring of completed buckets plus one open bucket that only
+// the sampling thread touches. A bucket is published by advancing the
+// level's closed-bucket count; readers copy and then check that the ring
+// did not wrap onto what they copied.
+
+#include "hal/sample_pyramid.h"
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#define NS_PER_SECOND 1000000000LL
+
+// Completed buckets kept per level
+#define NUM_SECOND_BUCKETS (60 * 60)  // 1 hour
+#define NUM_MINUTE_BUCKETS (24 * 60)  // 1 day
+#define NUM_HOUR_BUCKETS (7 * 24)     // 1 week
+
+typedef struct
+{
+    long long start_ns;
+    uint64_t sum_codes;
+    uint32_t count;
+    uint16_t min_code;
+    uint16_t max_code;
+} bucket_t;
+
+typedef struct
+{
+    long long width_ns;
+    int capacity;
+    bucket_t *ring;
+
+    // Only used by the sampling thread
+    bucket_t open;
+    bool has_open;
+
+    // Number of buckets ever closed; ring[n % capacity] is bucket n
+    atomic_ullong num_closed;
+} level_t;
+
+static bucket_t second_ring[NUM_SECOND_BUCKETS];
+static bucket_t minute_ring[NUM_MINUTE_BUCKETS];
+static bucket_t hour_ring[NUM_HOUR_BUCKETS];
+
+static level_t levels[NUM_SAMPLER_RESOLUTIONS] = {
+    [SAMPLER_RESOLUTION_SECOND] = {NS_PER_SECOND, NUM_SECOND_BUCKETS, second_ring},
+    [SAMPLER_RESOLUTION_MINUTE] = {60 * NS_PER_SECOND, NUM_MINUTE_BUCKETS, minute_ring},
+    [SAMPLER_RESOLUTION_HOUR] = {60 * 60 * NS_PER_SECOND, NUM_HOUR_BUCKETS, hour_ring},
+};
+
+static void add_to_level(int level, const bucket_t *pBucket);
+static void merge_bucket(bucket_t *pInto, const bucket_t *pFrom);
+
+void SamplePyramid_init(void)
+{
+    for (int i = 0; i < NUM_SAMPLER_RESOLUTIONS; i++)
+    {
+        memset(levels[i].ring, 0, levels[i].capacity * sizeof(bucket_t));
+        levels[i].has_open = false;
+        atomic_store(&levels[i].num_closed, 0);
+    }
+}
+
+void SamplePyramid_addSample(uint16_t code, long long timestamp_ns)
+{
+    bucket_t sample = {
+        .start_ns = timestamp_ns,
+        .sum_codes = code,
+        .count = 1,
+        .min_code = code,
+        .max_code = code,
+    };
+    add_to_level(SAMPLER_RESOLUTION_SECOND, &sample);
+}
+
+// Merge `pBucket` into the level's open bucket. If it belongs to a later
+// period, publish the open bucket, pass it up to the next level, and open
+// a new one aligned to the level's width.
+static void add_to_level(int level, const bucket_t *pBucket)
+{
+    level_t *pLevel = &levels[level];
+    long long period = pBucket->start_ns / pLevel->width_ns;
+
+    if (pLevel->has_open && pLevel->open.start_ns / pLevel->width_ns == period)
+    {
+        merge_bucket(&pLevel->open, pBucket);
+        return;
+    }
+
+    if (pLevel->has_open)
+    {
+        unsigned long long closed = atomic_load_explicit(&pLevel->num_closed,
+                                                         memory_order_relaxed);
+        pLevel->ring[closed % pLevel->capacity] = pLevel->open;
+        atomic_store_explicit(&pLevel->num_closed, closed + 1, memory_order_release);
+
+        if (level + 1 < NUM_SAMPLER_RESOLUTIONS)
+        {
+            add_to_level(level + 1, &pLevel->open);
+        }
+    }
+
+    pLevel->open = *pBucket;
+    pLevel->open.start_ns = period * pLevel->width_ns;
+    pLevel->has_open = true;
+}
+
+static void merge_bucket(bucket_t *pInto, const bucket_t *pFrom)
+{
+    pInto->sum_codes += pFrom->sum_codes;
+    pInto->count += pFrom->count;
+    if (pFrom->min_code < pInto->min_code)
+    {
+        pInto->min_code = pFrom->min_code;
+    }
+    if (pFrom->max_code > pInto->max_code)
+    {
+        pInto->max_code = pFrom->max_code;
+    }
+}
+
+int SamplePyramid_read(enum Sampler_resolution resolution,
+                       Sampler_bucket_t *buckets, int max_buckets)
+{
+    level_t *pLevel = &levels[resolution];
+
+    // Leave one slot of headroom for the bucket the producer may be writing
+    if (max_buckets > pLevel->capacity - 1)
+    {
+        max_buckets = pLevel->capacity - 1;
+    }
+
+    const double volts_per_code = Sampler_codeToVoltage(1);
+    while (true)
+    {
+        unsigned long long closed = atomic_load_explicit(&pLevel->num_closed,
+                                                         memory_order_acquire);
+        int count = (closed < (unsigned long long)max_buckets) ? (int)closed : max_buckets;
+        unsigned long long first = closed - count;
+
+        for (int i = 0; i < count; i++)
+        {
+            const bucket_t *pBucket = &pLevel->ring[(first + i) % pLevel->capacity];
+            buckets[i].start_ns = pBucket->start_ns;
+            buckets[i].count = (int)pBucket->count;
+            buckets[i].min_voltage = Sampler_codeToVoltage(pBucket->min_code);
+            buckets[i].max_voltage = Sampler_codeToVoltage(pBucket->max_code);
+            buckets[i].mean_voltage = 0.0;
+            if (pBucket->count > 0)
+            {
+                buckets[i].mean_voltage =
+                    volts_per_code * pBucket->sum_codes / pBucket->count;
+            }
+        }
+
+        // Valid unless the producer has since started overwriting our oldest slot
+        atomic_thread_fence(memory_order_acquire);
+        unsigned long long now = atomic_load_explicit(&pLevel->num_closed,
+                                                      memory_order_relaxed);
+        if (now < first + pLevel->capacity)
+        {
+            return count;
+        }
+    }
+}
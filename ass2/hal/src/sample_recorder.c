@@ -0,0 +1,192 @@
+// Records light samples into a memory-mapped ring file.
+// The sampling thread only stores into the mapping and bumps num_written;
+// the flush thread msync()s the pages written since its last pass.
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#include "hal/sample_recorder.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#define FLUSH_INTERVAL_MS 1000
+
+static bool is_recording = false;
+static int file_desc = -1;
+static size_t map_size = 0;
+static SampleRecorder_header_t *pHeader = NULL;
+static SampleRecorder_record_t *records = NULL;
+
+static pthread_t flush_thread;
+static pthread_mutex_t stop_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stop_cond = PTHREAD_COND_INITIALIZER;
+static bool should_stop = false;
+
+// Only used by the flush thread (and cleanup, after it has stopped)
+static uint64_t num_flushed = 0;
+
+static void *flush_thread_function();
+static void flush_written_records(void);
+static void sync_range(uint64_t first, uint64_t count);
+
+bool SampleRecorder_init(const char *path, uint64_t capacity, double volts_per_code)
+{
+    printf("Sample Recorder - Recording to %s\n", path);
+
+    file_desc = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file_desc == -1)
+    {
+        perror("Unable to open recording file");
+        return false;
+    }
+
+    // Allocate every block up front so storing a record never extends the file
+    map_size = sizeof(SampleRecorder_header_t) + capacity * sizeof(SampleRecorder_record_t);
+    int error = posix_fallocate(file_desc, 0, map_size);
+    if (error != 0)
+    {
+        printf("Unable to allocate recording file: %s\n", strerror(error));
+        close(file_desc);
+        file_desc = -1;
+        return false;
+    }
+
+    void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, file_desc, 0);
+    if (map == MAP_FAILED)
+    {
+        perror("Unable to map recording file");
+        close(file_desc);
+        file_desc = -1;
+        return false;
+    }
+
+    pHeader = map;
+    records = (SampleRecorder_record_t *)(pHeader + 1);
+    memcpy(pHeader->magic, SAMPLE_RECORDER_MAGIC, sizeof(pHeader->magic));
+    pHeader->version = SAMPLE_RECORDER_VERSION;
+    pHeader->record_size = sizeof(SampleRecorder_record_t);
+    pHeader->capacity = capacity;
+    pHeader->volts_per_code = volts_per_code;
+    atomic_store(&pHeader->num_written, 0);
+    num_flushed = 0;
+
+    should_stop = false;
+    pthread_create(&flush_thread, NULL, flush_thread_function, NULL);
+
+    is_recording = true;
+    return true;
+}
+
+void SampleRecorder_cleanup(void)
+{
+    if (!is_recording)
+    {
+        return;
+    }
+    printf("Sample Recorder - Cleanup\n");
+
+    // Wake the flush thread so shutdown does not wait out a full interval
+    pthread_mutex_lock(&stop_mutex);
+    should_stop = true;
+    pthread_cond_signal(&stop_cond);
+    pthread_mutex_unlock(&stop_mutex);
+    pthread_join(flush_thread, NULL);
+
+    is_recording = false;
+    flush_written_records();
+    fdatasync(file_desc);
+
+    munmap(pHeader, map_size);
+    close(file_desc);
+    pHeader = NULL;
+    records = NULL;
+    file_desc = -1;
+}
+
+void SampleRecorder_record(uint16_t code, long long timestamp_ns)
+{
+    if (!is_recording)
+    {
+        return;
+    }
+
+    uint64_t n = atomic_load_explicit(&pHeader->num_written, memory_order_relaxed);
+    SampleRecorder_record_t *pRecord = &records[n % pHeader->capacity];
+    pRecord->timestamp_ns = timestamp_ns;
+    pRecord->code = code;
+    atomic_store_explicit(&pHeader->num_written, n + 1, memory_order_release);
+}
+
+static void *flush_thread_function()
+{
+    pthread_mutex_lock(&stop_mutex);
+    while (!should_stop)
+    {
+        struct timespec wake_time;
+        clock_gettime(CLOCK_REALTIME, &wake_time);
+        wake_time.tv_sec += FLUSH_INTERVAL_MS / 1000;
+        pthread_cond_timedwait(&stop_cond, &stop_mutex, &wake_time);
+
+        pthread_mutex_unlock(&stop_mutex);
+        flush_written_records();
+        pthread_mutex_lock(&stop_mutex);
+    }
+    pthread_mutex_unlock(&stop_mutex);
+    return NULL;
+}
+
+// Write back records added since the last flush, plus the header
+static void flush_written_records(void)
+{
+    uint64_t written = atomic_load_explicit(&pHeader->num_written, memory_order_acquire);
+    uint64_t capacity = pHeader->capacity;
+
+    // If the ring lapped us, everything is dirty
+    uint64_t first = num_flushed;
+    if (written - first > capacity)
+    {
+        first = written - capacity;
+    }
+
+    // Split the range where it wraps around the end of the ring
+    uint64_t start_slot = first % capacity;
+    uint64_t count = written - first;
+    uint64_t until_end = capacity - start_slot;
+    if (count > until_end)
+    {
+        sync_range(start_slot, until_end);
+        sync_range(0, count - until_end);
+    }
+    else
+    {
+        sync_range(start_slot, count);
+    }
+
+    msync(pHeader, sizeof(*pHeader), MS_SYNC);
+    num_flushed = written;
+}
+
+// msync() the pages holding records [first, first + count)
+static void sync_range(uint64_t first, uint64_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    long page_size = sysconf(_SC_PAGESIZE);
+    char *start = (char *)&records[first];
+    char *end = (char *)&records[first + count];
+    char *page_start = (char *)((uintptr_t)start & ~(uintptr_t)(page_size - 1));
+    if (msync(page_start, end - page_start, MS_SYNC) == -1)
+    {
+        perror("Unable to flush recording");
+    }
+}
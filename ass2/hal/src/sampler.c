@@ -1,332 +1,765 @@
 // This file continually samples the light sensor using a thread,
 // with multiple helper functions that compute average, get total number of samples etc.
-// also enables the light sensor on zen hat to read light using I2C
+// Samples come from a pluggable LightSource (the Zen Hat's sensor by default)
 
+#define _POSIX_C_SOURCE 200809L
 #include "hal/sampler.h"
 #include "hal/periodTimer.h"
+#include "hal/sample_archive.h"
+#include "hal/sample_pyramid.h"
+#include "hal/sample_recorder.h"
+#include "hal/light_source.h"
+#include "hal/light_spectrum.h"
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <stdbool.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <sys/ioctl.h>
-#include <linux/i2c.h>
-#include <linux/i2c-dev.h>
 #include <stdint.h>
+#include <stdatomic.h>
 #include <pthread.h>
+#include <sched.h>
 #include <string.h>
-
-// Device bus & address
-#define I2CDRV_LINUX_BUS "/dev/i2c-1"
-#define I2C_DEVICE_ADDRESS 0x48
-
-// Register in TLA2024
-#define REG_CONFIGURATION 0x01
-#define REG_DATA 0x00
-
-// Configuration for channel 2 (E)
-#define TLA2024_CHANNEL_CONF_2 0x83E2
+#include <errno.h>
 
 // ADC Configuration
 #define ADC_MAX_VALUE 4096.0 // 12-bit ADC
 #define ADC_VREF 3.3         // Reference voltage is 3.3V
+#define VOLTS_PER_CODE (ADC_VREF / ADC_MAX_VALUE)
 
 // Sampling configuration
-#define MAX_SAMPLES_PER_SECOND 700
+#define MIN_SAMPLE_RATE_HZ 1
+#define MAX_SAMPLE_RATE_HZ 3300 // Also the limit on ADC reads/s when oversampling
+#define MAX_OVERSAMPLING 64
+#define NS_PER_SECOND 1000000000LL
+#define NS_PER_MS (1000 * 1000.0)
 #define SMOOTHING_FACTOR 0.999 // 99.9% weight for previous average
 #define DIP_THRESHOLD 0.1      // Voltage must drop by 0.1V to count as dip
 #define HYSTERESIS 0.03        // Must rise by 0.07V (0.1 - 0.03) before can trigger again
+#define DIP_THRESHOLD_CODES (DIP_THRESHOLD / VOLTS_PER_CODE)
+#define RESET_THRESHOLD_CODES ((DIP_THRESHOLD - HYSTERESIS) / VOLTS_PER_CODE)
+
+// Number of one-second buffers the sampler rotates through: one being
+// filled, one published as history, one keeping the previous history
+// readable, and one about to be handed back to the sampling thread.
+#define NUM_SECOND_BUFFERS 4
 
-// Thread and synchronization
+// Each second buffer holds this many seconds worth of samples at the
+// configured rate, so a late call to Sampler_moveCurrentDataToHistory()
+// does not lose samples.
+#define BUFFER_SECONDS_NUM 3
+#define BUFFER_SECONDS_DEN 2
+
+// Thread control
 static pthread_t sampling_thread;
-static pthread_mutex_t data_mutex = PTHREAD_MUTEX_INITIALIZER;
-static int i2c_file_desc = -1;
 static volatile bool should_stop = false;
 static bool is_initialized = false;
 
+// Where samples come from. In manual mode there is no sampling thread:
+// the caller drives sampling with Sampler_runSamples() on simulated time.
+static const LightSource_t *pSource = &LightSource_tla2024;
+static bool manual_mode = false;
+static long long manual_time_ns = 0;
+
 // Sampling data
-static double current_samples[MAX_SAMPLES_PER_SECOND];
-static int current_sample_count = 0;
-static double history_samples[MAX_SAMPLES_PER_SECOND];
-static int history_sample_count = 0;
-static double current_average = 0.0;
+// Samples are stored as raw 12-bit ADC codes, with their timestamps in a
+// separate array so code-only consumers touch 2 bytes per sample.
+// Second buffer N % NUM_SECOND_BUFFERS holds the samples of history generation N.
+// - current_state: buffer index, dip count and sample count of the second being
+//   filled, packed by pack_current(). The sampling thread commits each sample
+//   (and any dip it starts) with a CAS; the flip swaps in an empty buffer with
+//   a single exchange, so no sample or dip is lost or double counted.
+// - history_state: (generation << 32) | sample count of the published second.
+static uint16_t *second_codes[NUM_SECOND_BUFFERS];
+static long long *second_timestamps[NUM_SECOND_BUFFERS];
+static Sampler_timing_t second_timing[NUM_SECOND_BUFFERS];
+static Sampler_spectrum_t second_spectrum[NUM_SECOND_BUFFERS];
+static int second_dips[NUM_SECOND_BUFFERS];
+static uint32_t buffer_capacity = 0;
+static atomic_ullong current_state = 0;
+static atomic_ullong history_state = 0;
+static atomic_ullong total_samples = 0;
+static _Atomic double current_average = 0.0; // in ADC codes
 static bool first_sample = true;
-static long long total_samples = 0;
 
-// Timing statistics for the previous second
-static double min_period_ms = 0.0;
-static double max_period_ms = 0.0;
-static double avg_period_ms = 0.0;
+// Dip detector state; only used by the sampling thread
+static bool waiting_for_reset = false;
+
+// Boxcar decimation filter state; only used by the sampling thread
+static uint32_t decimation_sum = 0;
+static int decimation_count = 0;
+
+// Field layout of current_state
+#define CURRENT_BUFFER_SHIFT 48
+#define CURRENT_DIPS_SHIFT 24
+#define CURRENT_FIELD_MASK 0xFFFFFF
+
+// Scheduler configuration and health counters (written by sampling thread only)
+// The thread reads the source every read_period_ns, oversampling_factor
+// reads per output sample.
+static int sample_rate_hz = 0;
+static int oversampling_factor = 1;
+static long long read_period_ns = 0;
+static atomic_llong late_wakeups = 0;
+static atomic_llong overruns = 0;
+static atomic_llong dropped_samples = 0;
+
+// Event listener; may be set or cleared while sampling.
+// listener_calls counts notify() calls that may be using the old listener.
+static _Atomic Sampler_listener_t listener = NULL;
+static atomic_int listener_calls = 0;
+
+// Per-second snapshot, written only by Sampler_moveCurrentDataToHistory().
+// snapshot_sequence is odd while a new snapshot is being written.
+static atomic_uint snapshot_sequence = 0;
+static Sampler_snapshot_t snapshot;
+
+// Timestamp of the last sample moved into history; only used by the
+// thread calling Sampler_moveCurrentDataToHistory()
+static long long last_history_timestamp_ns = 0;
 
 // Forward declarations
-static int init_i2c_bus(char *bus, int address);
-static void write_i2c_reg16(int i2c_file_desc, uint8_t reg_addr, uint16_t value);
-static uint16_t read_i2c_reg16(int i2c_file_desc, uint8_t reg_addr);
-static double convert_to_voltage(uint16_t raw_value);
-static double read_light_value(void);
 static void *sampling_thread_function();
-static int analyze_dips(void);
-
-// I2C helper functions
-static int init_i2c_bus(char *bus, int address)
+static void init_common(int samples_per_second);
+static bool take_reading(uint16_t reading, long long timestamp_ns);
+static void take_sample(uint16_t code, long long timestamp_ns);
+static bool detect_dip_start(uint16_t code, double avg);
+static void store_sample(uint16_t code, long long timestamp_ns, bool dip_started);
+static void compute_timing(const long long *timestamps_ns, int size,
+                           Sampler_timing_t *pTiming);
+static void compute_spectrum(const uint16_t *codes, int size,
+                             Sampler_spectrum_t *pSpectrum);
+static void publish_snapshot(uint32_t generation, uint32_t buffer, int size);
+static void notify(enum Sampler_event event);
+static void timespec_add_ns(struct timespec *pTime, long long ns);
+static long long timespec_diff_ns(const struct timespec *pA, const struct timespec *pB);
+static uint64_t pack_state(uint32_t high, uint32_t count);
+static uint32_t state_high(uint64_t state);
+static uint32_t state_count(uint64_t state);
+static uint64_t pack_current(uint32_t buffer, uint32_t dips, uint32_t count);
+static uint32_t current_buffer(uint64_t state);
+static uint32_t current_dips(uint64_t state);
+static uint32_t current_count(uint64_t state);
+
+// Run one reading from the source through the decimation filter: a boxcar
+// (first-order CIC) that sums oversampling_factor readings in integer
+// arithmetic and emits their rounded mean as one sample.
+// Returns true if a sample was emitted.
+static bool take_reading(uint16_t reading, long long timestamp_ns)
 {
-    int i2c_file_desc = open(bus, O_RDWR);
-    if (i2c_file_desc == -1)
+    decimation_sum += reading;
+    if (++decimation_count < oversampling_factor)
     {
-        printf("I2C DRV: Unable to open bus for read/write (%s)\n", bus);
-        perror("Error is:");
-        exit(EXIT_FAILURE);
+        return false;
     }
 
-    if (ioctl(i2c_file_desc, I2C_SLAVE, address) == -1)
-    {
-        perror("Unable to set I2C device to slave address.");
-        exit(EXIT_FAILURE);
-    }
-    return i2c_file_desc;
+    uint16_t code = (decimation_sum + oversampling_factor / 2) / oversampling_factor;
+    decimation_sum = 0;
+    decimation_count = 0;
+
+    // Stamped with the last reading: when the sample became available
+    take_sample(code, timestamp_ns);
+    return true;
 }
 
-static void write_i2c_reg16(int i2c_file_desc, uint8_t reg_addr, uint16_t value)
+static void take_sample(uint16_t code, long long timestamp_ns)
 {
-    int tx_size = 1 + sizeof(value);
-    uint8_t buff[tx_size];
-    buff[0] = reg_addr;
-    buff[1] = (value & 0xFF);
-    buff[2] = (value & 0xFF00) >> 8;
-    int bytes_written = write(i2c_file_desc, buff, tx_size);
-    if (bytes_written != tx_size)
+    // Update exponential moving average (99.9% weight for previous average)
+    double avg = atomic_load_explicit(&current_average, memory_order_relaxed);
+    if (first_sample)
     {
-        perror("Unable to write i2c register");
-        exit(EXIT_FAILURE);
+        avg = code;
+        first_sample = false;
     }
-}
+    else
+    {
+        avg = (SMOOTHING_FACTOR * avg) + ((1.0 - SMOOTHING_FACTOR) * code);
+    }
+    atomic_store_explicit(&current_average, avg, memory_order_relaxed);
 
-static uint16_t read_i2c_reg16(int i2c_file_desc, uint8_t reg_addr)
-{
-    // To read a register, must first write the address
-    int bytes_written = write(i2c_file_desc, &reg_addr, sizeof(reg_addr));
-    if (bytes_written != sizeof(reg_addr))
+    bool dip_started = detect_dip_start(code, avg);
+    store_sample(code, timestamp_ns, dip_started);
+    if (dip_started)
     {
-        perror("Unable to write i2c register.");
-        exit(EXIT_FAILURE);
+        notify(SAMPLER_EVENT_DIP);
     }
+    SamplePyramid_addSample(code, timestamp_ns);
+    SampleArchive_addSample(code, timestamp_ns);
+    SampleRecorder_record(code, timestamp_ns);
+    atomic_fetch_add_explicit(&total_samples, 1, memory_order_relaxed);
+}
+
+// Reads on absolute deadlines so the rate does not drift with I2C time
+// or wake-up delay. A read that runs past whole periods skips them
+// (counted as overruns) rather than bursting to catch up.
+static void *sampling_thread_function()
+{
+    const long long late_threshold_ns = read_period_ns / 4;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
 
-    // Now read the value and return it
-    uint16_t value = 0;
-    int bytes_read = read(i2c_file_desc, &value, sizeof(value));
-    if (bytes_read != sizeof(value))
+    while (!should_stop)
     {
-        perror("Unable to read i2c register");
-        exit(EXIT_FAILURE);
+        // The source may wait for a fresh conversion, so stamp the reading
+        // when it arrives rather than when it was asked for
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint16_t reading = pSource->read(now.tv_sec * NS_PER_SECOND + now.tv_nsec);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (take_reading(reading, now.tv_sec * NS_PER_SECOND + now.tv_nsec))
+        {
+            Period_markEvent(PERIOD_EVENT_SAMPLE_LIGHT);
+        }
+
+        timespec_add_ns(&deadline, read_period_ns);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long behind_ns = timespec_diff_ns(&now, &deadline);
+        if (behind_ns >= read_period_ns)
+        {
+            long long missed = behind_ns / read_period_ns;
+            atomic_fetch_add_explicit(&overruns, missed, memory_order_relaxed);
+            timespec_add_ns(&deadline, missed * read_period_ns);
+        }
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+        {
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (timespec_diff_ns(&now, &deadline) > late_threshold_ns)
+        {
+            atomic_fetch_add_explicit(&late_wakeups, 1, memory_order_relaxed);
+        }
     }
-    return value;
+    return NULL;
 }
 
-static double convert_to_voltage(uint16_t raw_value)
+void Sampler_setSource(const LightSource_t *pNewSource)
 {
-    // Simple conversion: (3.3V / 4096) * ADC_value
-    return (ADC_VREF / ADC_MAX_VALUE) * raw_value;
+    assert(!is_initialized);
+    assert(pNewSource);
+    pSource = pNewSource;
 }
 
-static double read_light_value(void)
+void Sampler_setOversampling(int factor)
 {
-    // Read raw value (LSB first)
-    uint16_t raw_read = read_i2c_reg16(i2c_file_desc, REG_DATA);
+    assert(!is_initialized);
+    assert(factor >= 1 && factor <= MAX_OVERSAMPLING);
+    oversampling_factor = factor;
+}
 
-    // Convert from LSB first to MSB first
-    uint16_t value = ((raw_read & 0xFF) << 8) | ((raw_read & 0xFF00) >> 8);
+void Sampler_init(int samples_per_second)
+{
+    printf("Sampler - Initializing at %d samples/s from %s\n",
+           samples_per_second, pSource->name);
+    assert(!is_initialized);
+    init_common(samples_per_second);
 
-    // Right align the 12-bit value
-    value = value >> 4;
+    // Start sampling thread
+    manual_mode = false;
+    pthread_create(&sampling_thread, NULL, sampling_thread_function, NULL);
 
-    // Convert to voltage
-    return convert_to_voltage(value);
+    is_initialized = true;
 }
 
-static void *sampling_thread_function()
+void Sampler_initManual(int samples_per_second)
 {
-    struct timespec sleep_time = {0, 1000000}; // 1ms = 1,000,000 ns
+    printf("Sampler - Initializing manual sampling at %d samples/s from %s\n",
+           samples_per_second, pSource->name);
+    assert(!is_initialized);
+    init_common(samples_per_second);
 
-    while (!should_stop)
+    // Simulated time starts at the real time so timestamps look normal
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    manual_time_ns = now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+    manual_mode = true;
+
+    is_initialized = true;
+}
+
+void Sampler_runSamples(int num_samples)
+{
+    assert(is_initialized && manual_mode);
+    for (int i = 0; i < num_samples * oversampling_factor; i++)
     {
-        double sample = read_light_value();
-        Period_markEvent(PERIOD_EVENT_SAMPLE_LIGHT);
+        take_reading(pSource->read(manual_time_ns), manual_time_ns);
+        manual_time_ns += read_period_ns;
+    }
+}
 
-        pthread_mutex_lock(&data_mutex);
+// Setup shared by threaded and manual sampling
+static void init_common(int samples_per_second)
+{
+    int reads_per_second = samples_per_second * oversampling_factor;
+    assert(samples_per_second >= MIN_SAMPLE_RATE_HZ &&
+           reads_per_second <= MAX_SAMPLE_RATE_HZ);
+    if (oversampling_factor > 1)
+    {
+        printf("Sampler - Oversampling %dx: %d reads/s\n",
+               oversampling_factor, reads_per_second);
+    }
 
-        // Update total samples count
-        total_samples++;
+    sample_rate_hz = samples_per_second;
+    read_period_ns = NS_PER_SECOND / reads_per_second;
 
-        // Update exponential moving average (99.9% weight for previous average)
-        if (first_sample)
+    // Size the second buffers to match the rate
+    buffer_capacity = samples_per_second * BUFFER_SECONDS_NUM / BUFFER_SECONDS_DEN;
+    for (int i = 0; i < NUM_SECOND_BUFFERS; i++)
+    {
+        second_codes[i] = malloc(buffer_capacity * sizeof(uint16_t));
+        second_timestamps[i] = malloc(buffer_capacity * sizeof(long long));
+        if (!second_codes[i] || !second_timestamps[i])
         {
-            current_average = sample;
-            first_sample = false;
+            perror("Unable to allocate sample buffers");
+            exit(EXIT_FAILURE);
         }
-        else
+    }
+
+    pSource->open(reads_per_second);
+
+    // Reset all counters and flags
+    should_stop = false;
+    atomic_store(&current_state, pack_current(1, 0, 0));
+    atomic_store(&history_state, pack_state(0, 0));
+    atomic_store(&total_samples, 0);
+    memset(second_dips, 0, sizeof(second_dips));
+    waiting_for_reset = false;
+    decimation_sum = 0;
+    decimation_count = 0;
+    SamplePyramid_init();
+    SampleArchive_init();
+    atomic_store(&late_wakeups, 0);
+    atomic_store(&overruns, 0);
+    atomic_store(&dropped_samples, 0);
+    memset(second_timing, 0, sizeof(second_timing));
+    memset(second_spectrum, 0, sizeof(second_spectrum));
+    atomic_store(&snapshot_sequence, 0);
+    memset(&snapshot, 0, sizeof(snapshot));
+    LightSpectrum_init(buffer_capacity);
+    last_history_timestamp_ns = 0;
+    first_sample = true;
+}
+
+void Sampler_cleanup(void)
+{
+    printf("Sampler - Cleanup\n");
+    assert(is_initialized);
+
+    // Stop sampling thread
+    if (!manual_mode)
+    {
+        should_stop = true;
+        pthread_join(sampling_thread, NULL);
+    }
+
+    pSource->close();
+    LightSpectrum_cleanup();
+
+    for (int i = 0; i < NUM_SECOND_BUFFERS; i++)
+    {
+        free(second_codes[i]);
+        free(second_timestamps[i]);
+        second_codes[i] = NULL;
+        second_timestamps[i] = NULL;
+    }
+
+    is_initialized = false;
+}
+
+// Hysteresis state machine, run on every sample against the running average.
+// A dip starts when the light drops DIP_THRESHOLD below the average, and no
+// new dip can start until it rises back within DIP_THRESHOLD - HYSTERESIS.
+// The state carries over between seconds, so a dip that straddles the
+// boundary is counted once, in the second it started.
+// Works directly on ADC codes; only relative levels matter.
+static bool detect_dip_start(uint16_t code, double avg)
+{
+    double diff = avg - code;
+
+    if (!waiting_for_reset)
+    {
+        if (diff >= DIP_THRESHOLD_CODES)
         {
-            current_average = (SMOOTHING_FACTOR * current_average) +
-                              ((1.0 - SMOOTHING_FACTOR) * sample);
+            waiting_for_reset = true;
+            return true;
         }
+    }
+    else if (diff <= RESET_THRESHOLD_CODES)
+    {
+        waiting_for_reset = false;
+    }
+    return false;
+}
 
-        // Store sample in current buffer if there's room
-        if (current_sample_count < MAX_SAMPLES_PER_SECOND)
+// Append a sample to the second currently being filled.
+// If the buffers were flipped between reading the state and committing,
+// the CAS fails and the sample is stored into the new buffer instead.
+static void store_sample(uint16_t code, long long timestamp_ns, bool dip_started)
+{
+    const uint64_t increment = 1 + (dip_started ? (1ULL << CURRENT_DIPS_SHIFT) : 0);
+
+    uint64_t state = atomic_load_explicit(&current_state, memory_order_acquire);
+    while (true)
+    {
+        uint32_t count = current_count(state);
+        if (count >= buffer_capacity)
         {
-            current_samples[current_sample_count++] = sample;
+            atomic_fetch_add_explicit(&dropped_samples, 1, memory_order_relaxed);
+            return;
         }
 
-        pthread_mutex_unlock(&data_mutex);
+        uint32_t buffer = current_buffer(state);
+        second_codes[buffer][count] = code;
+        second_timestamps[buffer][count] = timestamp_ns;
+        if (atomic_compare_exchange_weak_explicit(&current_state, &state, state + increment,
+                                                  memory_order_release,
+                                                  memory_order_acquire))
+        {
+            return;
+        }
+    }
+}
 
-        nanosleep(&sleep_time, NULL);
+void Sampler_moveCurrentDataToHistory(void)
+{
+    // The buffer being filled belongs to the next generation; the one after
+    // that becomes the new current buffer. It still holds generation - 3,
+    // which history_state does not retire until the store below, so
+    // Sampler_isHistoryValid() already treats it as overwritten.
+    uint32_t generation = state_high(atomic_load(&history_state)) + 1;
+    uint32_t next_buffer = (generation + 1) % NUM_SECOND_BUFFERS;
+
+    uint64_t closed = atomic_exchange_explicit(&current_state,
+                                               pack_current(next_buffer, 0, 0),
+                                               memory_order_acq_rel);
+
+    // Dips, timing and spectrum travel with the buffer, published by the same store
+    uint32_t buffer = current_buffer(closed);
+    int size = (int)current_count(closed);
+    second_dips[buffer] = (int)current_dips(closed);
+    compute_timing(second_timestamps[buffer], size, &second_timing[buffer]);
+    compute_spectrum(second_codes[buffer], size, &second_spectrum[buffer]);
+    if (size > 0)
+    {
+        last_history_timestamp_ns = second_timestamps[buffer][size - 1];
     }
-    return NULL;
+
+    atomic_store_explicit(&history_state, pack_state(generation, size),
+                          memory_order_release);
+    publish_snapshot(generation, buffer, size);
+    notify(SAMPLER_EVENT_HISTORY_MOVED);
 }
 
-void Sampler_init(void)
+void Sampler_setListener(Sampler_listener_t new_listener)
 {
-    printf("Sampler - Initializing\n");
-    assert(!is_initialized);
+    atomic_store(&listener, new_listener);
 
-    // Initialize I2C and configure for channel 2
-    i2c_file_desc = init_i2c_bus(I2CDRV_LINUX_BUS, I2C_DEVICE_ADDRESS);
-    write_i2c_reg16(i2c_file_desc, REG_CONFIGURATION, TLA2024_CHANNEL_CONF_2);
+    // Wait out calls that loaded the old listener. Both sides are seq_cst:
+    // a notify() that registers after we see no calls loads the new one.
+    while (atomic_load(&listener_calls) > 0)
+    {
+        sched_yield();
+    }
+}
 
-    // Reset all counters and flags
-    should_stop = false;
-    current_sample_count = 0;
-    history_sample_count = 0;
-    first_sample = true;
-    total_samples = 0;
+static void notify(enum Sampler_event event)
+{
+    atomic_fetch_add(&listener_calls, 1);
+    Sampler_listener_t current = atomic_load(&listener);
+    if (current)
+    {
+        current(event);
+    }
+    atomic_fetch_sub_explicit(&listener_calls, 1, memory_order_release);
+}
 
-    // Start sampling thread
-    pthread_create(&sampling_thread, NULL, sampling_thread_function, NULL);
+static void publish_snapshot(uint32_t generation, uint32_t buffer, int size)
+{
+    unsigned sequence = atomic_load_explicit(&snapshot_sequence, memory_order_relaxed);
+    atomic_store_explicit(&snapshot_sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    snapshot.generation = generation;
+    snapshot.history_size = size;
+    snapshot.dips = second_dips[buffer];
+    snapshot.average_voltage = Sampler_getAverageReading();
+    snapshot.num_samples_taken = Sampler_getNumSamplesTaken();
+    snapshot.timing = second_timing[buffer];
+    snapshot.spectrum = second_spectrum[buffer];
+    Sampler_getScheduleStats(&snapshot.schedule);
+
+    atomic_store_explicit(&snapshot_sequence, sequence + 2, memory_order_release);
+}
 
-    is_initialized = true;
+void Sampler_getSnapshot(Sampler_snapshot_t *pSnapshot)
+{
+    unsigned before;
+    unsigned after;
+    do
+    {
+        before = atomic_load_explicit(&snapshot_sequence, memory_order_acquire);
+        *pSnapshot = snapshot;
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&snapshot_sequence, memory_order_relaxed);
+    } while ((before & 1) || before != after);
 }
 
-void Sampler_cleanup(void)
+// Compute sampling period statistics for one second of samples.
+// The first period is measured from the last sample of the previous second.
+static void compute_timing(const long long *timestamps_ns, int size,
+                           Sampler_timing_t *pTiming)
 {
-    printf("Sampler - Cleanup\n");
-    assert(is_initialized);
+    long long start_ns = last_history_timestamp_ns;
+    int first = 0;
+    if (start_ns == 0 && size > 0)
+    {
+        // No previous second yet: start from this second's first sample
+        start_ns = timestamps_ns[0];
+        first = 1;
+    }
 
-    // Stop sampling thread
-    should_stop = true;
-    pthread_join(sampling_thread, NULL);
+    long long prev_ns = start_ns;
+    long long min_ns = 0;
+    long long max_ns = 0;
+    long long sum_ns = 0;
+    for (int i = first; i < size; i++)
+    {
+        long long delta_ns = timestamps_ns[i] - prev_ns;
+        if (i == first || delta_ns < min_ns)
+        {
+            min_ns = delta_ns;
+        }
+        if (i == first || delta_ns > max_ns)
+        {
+            max_ns = delta_ns;
+        }
+        sum_ns += delta_ns;
+        prev_ns = timestamps_ns[i];
+    }
+
+    int num_periods = (size > first) ? size - first : 0;
+    double avg_ns = (num_periods > 0) ? (double)sum_ns / num_periods : 0.0;
 
-    // Cleanup I2C
-    if (i2c_file_desc >= 0)
+    // Jitter: mean absolute deviation of each period from the average
+    double deviation_ns = 0.0;
+    prev_ns = start_ns;
+    for (int i = first; i < size; i++)
     {
-        close(i2c_file_desc);
-        i2c_file_desc = -1;
+        double delta_ns = (double)(timestamps_ns[i] - prev_ns);
+        deviation_ns += (delta_ns > avg_ns) ? delta_ns - avg_ns : avg_ns - delta_ns;
+        prev_ns = timestamps_ns[i];
     }
 
-    is_initialized = false;
+    pTiming->num_periods = num_periods;
+    pTiming->min_period_ms = min_ns / NS_PER_MS;
+    pTiming->max_period_ms = max_ns / NS_PER_MS;
+    pTiming->avg_period_ms = avg_ns / NS_PER_MS;
+    pTiming->jitter_ms = (num_periods > 0) ? deviation_ns / num_periods / NS_PER_MS : 0.0;
 }
 
-void Sampler_moveCurrentDataToHistory(void)
+static void compute_spectrum(const uint16_t *codes, int size,
+                             Sampler_spectrum_t *pSpectrum)
 {
-    pthread_mutex_lock(&data_mutex);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    LightSpectrum_peak_t peak;
+    LightSpectrum_findPeak(codes, size, sample_rate_hz, &peak);
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    pSpectrum->dominant_hz = peak.dominant_hz;
+    pSpectrum->magnitude_volts = peak.magnitude * VOLTS_PER_CODE;
+    pSpectrum->fft_size = peak.fft_size;
+    pSpectrum->analysis_us = timespec_diff_ns(&end, &start) / 1000.0;
+}
 
-    // Copy current samples to history
-    memcpy(history_samples, current_samples, current_sample_count * sizeof(double));
-    history_sample_count = current_sample_count;
+void Sampler_getHistorySnapshot(Sampler_history_t *pHistory)
+{
+    uint64_t state = atomic_load_explicit(&history_state, memory_order_acquire);
+    pHistory->generation = state_high(state);
+    pHistory->size = (int)state_count(state);
+    uint32_t buffer = pHistory->generation % NUM_SECOND_BUFFERS;
+    pHistory->codes = second_codes[buffer];
+    pHistory->timestamps_ns = second_timestamps[buffer];
+    pHistory->timing = second_timing[buffer];
+    pHistory->spectrum = second_spectrum[buffer];
+    pHistory->dips = second_dips[buffer];
+}
 
-    // Reset current sample buffer
-    current_sample_count = 0;
+uint32_t Sampler_getHistoryGeneration(void)
+{
+    return state_high(atomic_load_explicit(&history_state, memory_order_acquire));
+}
 
-    pthread_mutex_unlock(&data_mutex);
+bool Sampler_isHistoryValid(const Sampler_history_t *pHistory)
+{
+    // Closing generation G hands the buffer of generation G - 3 back to the
+    // sampling thread (to fill G + 1) *before* G is published: while G's
+    // timing and spectrum are computed, history_state still says G - 1.
+    // So with history at H, generation H - 2 may already be overwritten;
+    // only H and H - 1 are safe. The fence orders the caller's reads of
+    // the samples before this check.
+    atomic_thread_fence(memory_order_acquire);
+    uint32_t age = Sampler_getHistoryGeneration() - pHistory->generation;
+    return age <= NUM_SECOND_BUFFERS - 3;
 }
 
 int Sampler_getHistorySize(void)
 {
-    pthread_mutex_lock(&data_mutex);
-    int size = history_sample_count;
-    pthread_mutex_unlock(&data_mutex);
-    return size;
+    return (int)state_count(atomic_load_explicit(&history_state, memory_order_acquire));
 }
 
 double *Sampler_getHistory(int *size)
 {
-    pthread_mutex_lock(&data_mutex);
+    double *copy = malloc(buffer_capacity * sizeof(double));
+    if (!copy)
+    {
+        *size = 0;
+        return NULL;
+    }
 
-    // Allocate and copy history data
-    double *copy = malloc(history_sample_count * sizeof(double));
-    memcpy(copy, history_samples, history_sample_count * sizeof(double));
-    *size = history_sample_count;
+    Sampler_history_t history;
+    do
+    {
+        Sampler_getHistorySnapshot(&history);
+        Sampler_codesToVoltages(history.codes, copy, history.size);
+    } while (!Sampler_isHistoryValid(&history));
 
-    pthread_mutex_unlock(&data_mutex);
+    *size = history.size;
     return copy;
 }
 
 double Sampler_getAverageReading(void)
 {
-    pthread_mutex_lock(&data_mutex);
-    double avg = current_average;
-    pthread_mutex_unlock(&data_mutex);
-    return avg;
+    return atomic_load_explicit(&current_average, memory_order_relaxed) * VOLTS_PER_CODE;
 }
 
-long long Sampler_getNumSamplesTaken(void)
+double Sampler_codeToVoltage(uint16_t code)
 {
-    pthread_mutex_lock(&data_mutex);
-    long long count = total_samples;
-    pthread_mutex_unlock(&data_mutex);
-    return count;
+    // Simple conversion: (3.3V / 4096) * ADC_value
+    return code * VOLTS_PER_CODE;
 }
 
-// Returns number of dips detected in the history buffer
-static int analyze_dips(void)
+void Sampler_codesToVoltages(const uint16_t *restrict codes,
+                             double *restrict voltages, int count)
 {
-    const double RESET_THRESHOLD = DIP_THRESHOLD - HYSTERESIS;
+    // Kept branch-free and alias-free so the compiler vectorizes it
+    for (int i = 0; i < count; i++)
+    {
+        voltages[i] = codes[i] * VOLTS_PER_CODE;
+    }
+}
 
-    int dip_count = 0;
-    bool waiting_for_reset = false;
+long long Sampler_getNumSamplesTaken(void)
+{
+    return (long long)atomic_load_explicit(&total_samples, memory_order_relaxed);
+}
 
-    pthread_mutex_lock(&data_mutex);
+int Sampler_getSampleRate(void)
+{
+    return sample_rate_hz;
+}
 
-    // Get current average for reference
-    double avg = current_average;
+void Sampler_getScheduleStats(Sampler_schedule_stats_t *pStats)
+{
+    pStats->late_wakeups = atomic_load_explicit(&late_wakeups, memory_order_relaxed);
+    pStats->overruns = atomic_load_explicit(&overruns, memory_order_relaxed);
+    pStats->dropped_samples = atomic_load_explicit(&dropped_samples, memory_order_relaxed);
 
-    // Look for dips in history buffer
-    for (int i = 0; i < history_sample_count; i++)
+    LightSource_stats_t source_stats = {0};
+    if (pSource->get_stats)
     {
-        double diff = avg - history_samples[i];
-
-        if (!waiting_for_reset)
-        {
-            // Looking for start of dip
-            if (diff >= DIP_THRESHOLD)
-            {
-                dip_count++;
-                waiting_for_reset = true;
-            }
-        }
-        else
-        {
-            // Waiting for voltage to rise before we can detect another dip
-            if (diff <= RESET_THRESHOLD)
-            {
-                waiting_for_reset = false;
-            }
-        }
+        pSource->get_stats(&source_stats);
     }
+    pStats->stale_reads = source_stats.stale_reads;
+    pStats->skipped_readings = source_stats.skipped_readings;
+}
+
+static void timespec_add_ns(struct timespec *pTime, long long ns)
+{
+    long long total_ns = pTime->tv_nsec + ns;
+    pTime->tv_sec += total_ns / NS_PER_SECOND;
+    pTime->tv_nsec = total_ns % NS_PER_SECOND;
+}
+
+// Returns a - b in nanoseconds
+static long long timespec_diff_ns(const struct timespec *pA, const struct timespec *pB)
+{
+    return (pA->tv_sec - pB->tv_sec) * NS_PER_SECOND + (pA->tv_nsec - pB->tv_nsec);
+}
+
+static uint64_t pack_state(uint32_t high, uint32_t count)
+{
+    return ((uint64_t)high << 32) | count;
+}
+
+static uint32_t state_high(uint64_t state)
+{
+    return (uint32_t)(state >> 32);
+}
+
+static uint32_t state_count(uint64_t state)
+{
+    return (uint32_t)state;
+}
+
+// Field accessors for current_state
+static uint64_t pack_current(uint32_t buffer, uint32_t dips, uint32_t count)
+{
+    return ((uint64_t)buffer << CURRENT_BUFFER_SHIFT) |
+           ((uint64_t)dips << CURRENT_DIPS_SHIFT) | count;
+}
+
+static uint32_t current_buffer(uint64_t state)
+{
+    return (uint32_t)(state >> CURRENT_BUFFER_SHIFT);
+}
+
+static uint32_t current_dips(uint64_t state)
+{
+    return (uint32_t)(state >> CURRENT_DIPS_SHIFT) & CURRENT_FIELD_MASK;
+}
 
-    pthread_mutex_unlock(&data_mutex);
-    return dip_count;
+static uint32_t current_count(uint64_t state)
+{
+    return (uint32_t)state & CURRENT_FIELD_MASK;
 }
 
 int Sampler_getDips(void)
 {
-    return analyze_dips();
+    Sampler_history_t history;
+    Sampler_getHistorySnapshot(&history);
+    return history.dips;
+}
+
+int Sampler_getTrend(enum Sampler_resolution resolution,
+                     Sampler_bucket_t *buckets, int max_buckets)
+{
+    assert(resolution >= 0 && resolution < NUM_SAMPLER_RESOLUTIONS);
+    return SamplePyramid_read(resolution, buckets, max_buckets);
+}
+
+int Sampler_getRange(long long start, uint16_t *codes, long long *timestamps_ns,
+                     int max_samples, Sampler_range_t *pRange)
+{
+    assert(max_samples >= 0);
+    return SampleArchive_read(start, codes, timestamps_ns, max_samples, pRange);
+}
+
+void Sampler_getTimingStats(Sampler_timing_t *pTiming)
+{
+    Sampler_history_t history;
+    Sampler_getHistorySnapshot(&history);
+    *pTiming = history.timing;
 }
 
-void Sampler_getTimingStats(double *min_ms, double *max_ms, double *avg_ms)
+void Sampler_getSpectrum(Sampler_spectrum_t *pSpectrum)
 {
-    pthread_mutex_lock(&data_mutex);
-    *min_ms = min_period_ms;
-    *max_ms = max_period_ms;
-    *avg_ms = avg_period_ms;
-    pthread_mutex_unlock(&data_mutex);
-}
\ No newline at end of file
+    Sampler_history_t history;
+    Sampler_getHistorySnapshot(&history);
+    *pSpectrum = history.spectrum;
+}
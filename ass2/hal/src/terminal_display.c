@@ -14,17 +14,20 @@
 static pthread_t display_thread;
 static volatile bool should_stop = false;
 static bool is_initialized = false;
+static Period_reader_t *pPeriodReader = NULL; // Our own window on the timing stats
 
 static void print_display_line(void)
 {
     // Get timing statistics
     Period_statistics_t stats;
-    Period_getStatisticsAndClear(PERIOD_EVENT_SAMPLE_LIGHT, &stats);
-
-    // Get other statistics
-    int samples = Sampler_getHistorySize();
-    double avg = Sampler_getAverageReading();
-    int dips = Sampler_getDips();
+    Period_getStatistics(pPeriodReader, &stats);
+
+    // Get other statistics, all from the same second
+    Sampler_snapshot_t snapshot;
+    Sampler_getSnapshot(&snapshot);
+    int samples = snapshot.history_size;
+    double avg = snapshot.average_voltage;
+    int dips = snapshot.dips;
     double flash_freq = PwmLed_getFrequency();
 
     // Print first line with fixed width fields
@@ -39,18 +42,18 @@ static void print_display_line(void)
            stats.numSamples);
 
     // Get and print 10 evenly spaced samples
-    int size;
-    double *history = Sampler_getHistory(&size);
-    if (history && size > 0)
+    Sampler_history_t history;
+    Sampler_getHistorySnapshot(&history);
+    int size = history.size;
+    if (size > 0)
     {
         int step = (size > 10) ? size / 10 : 1;
         for (int i = 0; i < size && i / step < 10; i += step)
         {
-            printf("%d:%.3f%s", i, history[i],
+            printf("%d:%.3f%s", i, Sampler_codeToVoltage(history.codes[i]),
                    (i / step == 9 || i + step >= size) ? "\n" : " ");
         }
     }
-    free(history);
 }
 
 static void *display_thread_function()
@@ -83,6 +86,7 @@ void TerminalDisplay_init(void)
 
     // Reset flags
     should_stop = false;
+    pPeriodReader = Period_openReader(PERIOD_EVENT_SAMPLE_LIGHT);
 
     // Create display thread
     pthread_create(&display_thread, NULL, display_thread_function, NULL);
@@ -98,6 +102,8 @@ void TerminalDisplay_cleanup(void)
     // Stop thread
     should_stop = true;
     pthread_join(display_thread, NULL);
+    Period_closeReader(pPeriodReader);
+    pPeriodReader = NULL;
 
     is_initialized = false;
 }
\ No newline at end of file
@@ -1,5 +1,9 @@
+#define _GNU_SOURCE // recvmmsg/sendmmsg
 #include "hal/udp_server.h"
 #include "hal/sampler.h"
+#include "hal/pwm_led.h"
+#include "hal/tla2024.h"
+#include "hal/history_packet.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,22 +16,104 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <assert.h>
+#include <time.h>
+#include <endian.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #define PORT 12345
 #define MAX_RESPONSE_SIZE 1500 // Maximum UDP packet size
 #define MAX_COMMAND_SIZE 100
+#define HISTORY_VALUES_PER_LINE 10
+#define MAX_TREND_BUCKETS 3600 // Largest level: one hour of seconds
+#define RANGE_MAX_PAGES 32 // Pages per "range" reply: one sendmmsg() batch
+#define NS_PER_SECOND 1000000000LL
+
+// Datagrams received / replies sent per system call
+#define RECV_BATCH 16
+#define SEND_BATCH 32
+
+// Client sessions: open-addressed hash table keyed by address and port.
+// A new client that finds no free slot within MAX_PROBES replaces the
+// least recently seen client there.
+#define MAX_CLIENTS 128 // Power of two
+#define MAX_PROBES 8
+
+// Subscriptions, pushed as the sampler raises events. A client must send
+// something (e.g. subscribe again) at least every SUBSCRIPTION_TIMEOUT_S
+// seconds or its subscriptions lapse.
+#define SUBSCRIBE_SUMMARY 0x1 // Per-second statistics line
+#define SUBSCRIBE_HISTORY 0x2 // Per-second samples, in "history binary" format
+#define SUBSCRIBE_DIPS 0x4    // A line as soon as dips start
+#define SUBSCRIPTION_TIMEOUT_S 30
+
+// A second of history at the highest sample rate, in binary fragments
+#define MAX_HISTORY_FRAGMENTS 8
+
+typedef struct {
+    bool in_use;
+    uint32_t ip;
+    uint16_t port;
+    long long last_seen_ns;
+    unsigned subscriptions;
+    char last_command[MAX_COMMAND_SIZE];
+} client_session_t;
 
 static pthread_t server_thread;
 static volatile bool should_stop = false;
 static bool is_initialized = false;
-static char last_command[MAX_COMMAND_SIZE] = "";
 static int sockfd = -1;
+static int epoll_fd = -1;
+static int shutdown_fd = -1; // eventfd written by UdpServer_cleanup()
+static int history_event_fd = -1; // eventfds written by the sampler listener
+static int dip_event_fd = -1;
+static Sampler_bucket_t trend_buckets[MAX_TREND_BUCKETS];
+
+// Only used by the server thread
+static client_session_t sessions[MAX_CLIENTS];
+
+// Incoming batch
+static char recv_buffers[RECV_BATCH][MAX_COMMAND_SIZE];
+static struct sockaddr_in recv_addrs[RECV_BATCH];
+static struct iovec recv_iovecs[RECV_BATCH];
+static struct mmsghdr recv_msgs[RECV_BATCH];
+
+// Replies queued while handling a batch, sent together by flush_replies()
+static char reply_buffers[SEND_BATCH][MAX_RESPONSE_SIZE];
+static struct sockaddr_in reply_addrs[SEND_BATCH];
+static struct iovec reply_iovecs[SEND_BATCH];
+static struct mmsghdr reply_msgs[SEND_BATCH];
+static int num_replies = 0;
+
+// Binary history fragments, built once per request or publish
+static uint8_t history_packets[MAX_HISTORY_FRAGMENTS][HISTORY_PACKET_MAX_SIZE];
+static size_t history_packet_sizes[MAX_HISTORY_FRAGMENTS];
 
 static void *server_thread_function();
-static void handle_command(const char *command, struct sockaddr_in *client_addr);
+static void receive_batch(void);
+static void handle_datagram(char *buffer, int length, struct sockaddr_in *client_addr);
+static void handle_subscription(const char *command, client_session_t *pSession,
+                                struct sockaddr_in *client_addr);
+static void sampler_listener(enum Sampler_event event);
+static void publish_history(void);
+static void publish_dips(void);
+static bool session_is_subscribed(client_session_t *pSession, unsigned subscription,
+                                  long long now_ns, struct sockaddr_in *pAddr);
+static int build_history_packets(void);
+static long long get_monotonic_ns(void);
+static client_session_t *find_session(const struct sockaddr_in *client_addr);
+static void queue_reply(const void *data, size_t length, const struct sockaddr_in *client_addr);
+static void flush_replies(void);
+static void handle_command(const char *command, client_session_t *pSession,
+                           struct sockaddr_in *client_addr);
 static void send_response(const char *response, struct sockaddr_in *client_addr);
 static void send_help_message(struct sockaddr_in *client_addr);
 static void send_history(struct sockaddr_in *client_addr);
+static void send_history_binary(struct sockaddr_in *client_addr);
+static void send_trend(const char *args, struct sockaddr_in *client_addr);
+static void send_range(const char *args, struct sockaddr_in *client_addr);
 
 void UdpServer_init(void)
 {
@@ -56,9 +142,50 @@ void UdpServer_init(void)
         exit(EXIT_FAILURE);
     }
 
+    // Wait on the socket, the shutdown event and the sampler's events together
+    epoll_fd = epoll_create1(0);
+    shutdown_fd = eventfd(0, 0);
+    history_event_fd = eventfd(0, EFD_NONBLOCK);
+    dip_event_fd = eventfd(0, EFD_NONBLOCK);
+    if (epoll_fd < 0 || shutdown_fd < 0 || history_event_fd < 0 || dip_event_fd < 0)
+    {
+        perror("Error creating server events");
+        exit(EXIT_FAILURE);
+    }
+    int watched_fds[] = {sockfd, shutdown_fd, history_event_fd, dip_event_fd};
+    for (size_t i = 0; i < sizeof(watched_fds) / sizeof(watched_fds[0]); i++)
+    {
+        struct epoll_event event = {.events = EPOLLIN, .data.fd = watched_fds[i]};
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, watched_fds[i], &event) < 0)
+        {
+            perror("Error registering server events");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Point each batch slot at its buffer once
+    for (int i = 0; i < RECV_BATCH; i++)
+    {
+        recv_iovecs[i].iov_base = recv_buffers[i];
+        recv_iovecs[i].iov_len = MAX_COMMAND_SIZE - 1;
+        recv_msgs[i].msg_hdr.msg_iov = &recv_iovecs[i];
+        recv_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    for (int i = 0; i < SEND_BATCH; i++)
+    {
+        reply_iovecs[i].iov_base = reply_buffers[i];
+        reply_msgs[i].msg_hdr.msg_iov = &reply_iovecs[i];
+        reply_msgs[i].msg_hdr.msg_iovlen = 1;
+        reply_msgs[i].msg_hdr.msg_name = &reply_addrs[i];
+        reply_msgs[i].msg_hdr.msg_namelen = sizeof(reply_addrs[i]);
+    }
+    memset(sessions, 0, sizeof(sessions));
+    num_replies = 0;
+
     // Start server thread
     should_stop = false;
     pthread_create(&server_thread, NULL, server_thread_function, NULL);
+    Sampler_setListener(sampler_listener);
 
     is_initialized = true;
     printf("UDP Server listening on port %d\n", PORT);
@@ -69,11 +196,28 @@ void UdpServer_cleanup(void)
     printf("UDP Server - Cleanup\n");
     assert(is_initialized);
 
-    // Stop server thread
+    // Detach from the sampler first: this waits for a listener call in
+    // progress, so nothing writes the eventfds once they are closed below.
+    // Then stop the server thread: the eventfd wakes it even if no client
+    // is talking.
+    Sampler_setListener(NULL);
     should_stop = true;
+    uint64_t wake = 1;
+    if (write(shutdown_fd, &wake, sizeof(wake)) != sizeof(wake))
+    {
+        perror("Error waking UDP server");
+    }
     pthread_join(server_thread, NULL);
 
-    // Cleanup socket
+    // Cleanup socket and events
+    close(epoll_fd);
+    close(shutdown_fd);
+    close(history_event_fd);
+    close(dip_event_fd);
+    epoll_fd = -1;
+    shutdown_fd = -1;
+    history_event_fd = -1;
+    dip_event_fd = -1;
     if (sockfd >= 0)
     {
         close(sockfd);
@@ -90,56 +234,199 @@ bool UdpServer_shouldStop(void)
 
 static void *server_thread_function()
 {
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
-    char buffer[MAX_COMMAND_SIZE];
+    while (!should_stop)
+    {
+        struct epoll_event events[4];
+        int num_events = epoll_wait(epoll_fd, events, 4, -1);
+        if (num_events < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("UDP server: epoll_wait failed");
+            break;
+        }
 
+        for (int i = 0; i < num_events; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == shutdown_fd)
+            {
+                return NULL;
+            }
+            else if (fd == history_event_fd)
+            {
+                publish_history();
+            }
+            else if (fd == dip_event_fd)
+            {
+                publish_dips();
+            }
+            else
+            {
+                receive_batch();
+            }
+        }
+        flush_replies();
+    }
+    return NULL;
+}
+
+// Runs on the sampler's threads: just wake the server thread
+static void sampler_listener(enum Sampler_event event)
+{
+    uint64_t one = 1;
+    int fd = (event == SAMPLER_EVENT_DIP) ? dip_event_fd : history_event_fd;
+    if (write(fd, &one, sizeof(one)) != sizeof(one))
+    {
+        // Counter saturated or server shutting down; nothing to do
+    }
+}
+
+// Drain the socket a batch at a time, answering each batch with as few
+// sendmmsg() calls as its replies need.
+static void receive_batch(void)
+{
     while (!should_stop)
     {
-        // Receive command
-        ssize_t n = recvfrom(sockfd, buffer, MAX_COMMAND_SIZE - 1, 0,
-                             (struct sockaddr *)&client_addr, &client_len);
+        for (int i = 0; i < RECV_BATCH; i++)
+        {
+            recv_msgs[i].msg_hdr.msg_name = &recv_addrs[i];
+            recv_msgs[i].msg_hdr.msg_namelen = sizeof(recv_addrs[i]);
+        }
 
-        if (n < 0)
+        int count = recvmmsg(sockfd, recv_msgs, RECV_BATCH, MSG_DONTWAIT, NULL);
+        if (count <= 0)
         {
-            continue; // Error receiving, try again
+            return; // Drained (EAGAIN) or error: back to epoll
         }
 
-        // Null terminate received data
-        buffer[n] = '\0';
+        for (int i = 0; i < count; i++)
+        {
+            handle_datagram(recv_buffers[i], recv_msgs[i].msg_len, &recv_addrs[i]);
+        }
+        flush_replies();
 
-        // Remove newline if present
-        if (n > 0 && buffer[n - 1] == '\n')
+        if (count < RECV_BATCH)
         {
-            buffer[n - 1] = '\0';
+            return;
         }
+    }
+}
+
+static void handle_datagram(char *buffer, int length, struct sockaddr_in *client_addr)
+{
+    // Null terminate received data
+    buffer[length] = '\0';
 
-        // Handle empty command (repeat last command)
-        if (strlen(buffer) == 0)
+    // Remove newline if present
+    if (length > 0 && buffer[length - 1] == '\n')
+    {
+        buffer[length - 1] = '\0';
+    }
+
+    client_session_t *pSession = find_session(client_addr);
+
+    // Handle empty command (repeat this client's last command)
+    if (strlen(buffer) == 0)
+    {
+        if (strlen(pSession->last_command) == 0)
         {
-            if (strlen(last_command) == 0)
-            {
-                send_response("Error: no previous command\n", &client_addr);
-            }
-            else
-            {
-                handle_command(last_command, &client_addr);
-            }
+            send_response("Error: no previous command\n", client_addr);
         }
         else
         {
-            // Save command and handle it
-            strncpy(last_command, buffer, MAX_COMMAND_SIZE - 1);
-            last_command[MAX_COMMAND_SIZE - 1] = '\0';
-            handle_command(buffer, &client_addr);
+            handle_command(pSession->last_command, pSession, client_addr);
         }
     }
-    return NULL;
+    else
+    {
+        // Save command and handle it
+        strncpy(pSession->last_command, buffer, MAX_COMMAND_SIZE - 1);
+        pSession->last_command[MAX_COMMAND_SIZE - 1] = '\0';
+        handle_command(buffer, pSession, client_addr);
+    }
+}
+
+// Find the client's session, creating it if needed
+static client_session_t *find_session(const struct sockaddr_in *client_addr)
+{
+    uint32_t ip = client_addr->sin_addr.s_addr;
+    uint16_t port = client_addr->sin_port;
+    uint32_t hash = (ip * 2654435761u) ^ (port * 40503u);
+
+    long long now_ns = get_monotonic_ns();
+
+    client_session_t *pOldest = NULL;
+    for (int probe = 0; probe < MAX_PROBES; probe++)
+    {
+        client_session_t *pSession = &sessions[(hash + probe) & (MAX_CLIENTS - 1)];
+        if (pSession->in_use && pSession->ip == ip && pSession->port == port)
+        {
+            pSession->last_seen_ns = now_ns;
+            return pSession;
+        }
+        if (!pSession->in_use)
+        {
+            // Slots are never emptied, so the client is not further along
+            pOldest = pSession;
+            break;
+        }
+        if (!pOldest || pSession->last_seen_ns < pOldest->last_seen_ns)
+        {
+            pOldest = pSession;
+        }
+    }
+
+    memset(pOldest, 0, sizeof(*pOldest));
+    pOldest->in_use = true;
+    pOldest->ip = ip;
+    pOldest->port = port;
+    pOldest->last_seen_ns = now_ns;
+    return pOldest;
+}
+
+static void queue_reply(const void *data, size_t length, const struct sockaddr_in *client_addr)
+{
+    assert(length <= MAX_RESPONSE_SIZE);
+    if (num_replies == SEND_BATCH)
+    {
+        flush_replies();
+    }
+
+    memcpy(reply_buffers[num_replies], data, length);
+    reply_iovecs[num_replies].iov_len = length;
+    reply_addrs[num_replies] = *client_addr;
+    num_replies++;
 }
 
-static void handle_command(const char *command, struct sockaddr_in *client_addr)
+static void flush_replies(void)
+{
+    int sent = 0;
+    while (sent < num_replies)
+    {
+        int count = sendmmsg(sockfd, reply_msgs + sent, num_replies - sent, 0);
+        if (count <= 0)
+        {
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            perror("UDP server: sendmmsg failed");
+            break;
+        }
+        sent += count;
+    }
+    num_replies = 0;
+}
+
+static void handle_command(const char *command, client_session_t *pSession,
+                           struct sockaddr_in *client_addr)
 {
     char response[MAX_RESPONSE_SIZE];
+    Sampler_snapshot_t snapshot;
+    Sampler_getSnapshot(&snapshot);
 
     if (strcmp(command, "help") == 0 || strcmp(command, "?") == 0)
     {
@@ -154,19 +441,63 @@ static void handle_command(const char *command, struct sockaddr_in *client_addr)
     else if (strcmp(command, "length") == 0)
     {
         snprintf(response, MAX_RESPONSE_SIZE, "# samples taken last second: %d\n",
-                 Sampler_getHistorySize());
+                 snapshot.history_size);
         send_response(response, client_addr);
     }
     else if (strcmp(command, "history") == 0)
     {
         send_history(client_addr);
     }
+    else if (strcmp(command, "history binary") == 0)
+    {
+        send_history_binary(client_addr);
+    }
+    else if (strncmp(command, "trend", 5) == 0 &&
+             (command[5] == '\0' || command[5] == ' '))
+    {
+        send_trend(command + 5, client_addr);
+    }
+    else if (strncmp(command, "range", 5) == 0 &&
+             (command[5] == '\0' || command[5] == ' '))
+    {
+        send_range(command + 5, client_addr);
+    }
     else if (strcmp(command, "dips") == 0)
     {
         snprintf(response, MAX_RESPONSE_SIZE, "# light dips detected: %d\n",
-                 Sampler_getDips());
+                 snapshot.dips);
         send_response(response, client_addr);
     }
+    else if (strcmp(command, "health") == 0)
+    {
+        Sampler_schedule_stats_t schedule;
+        Sampler_getScheduleStats(&schedule);
+        I2c_stats_t i2c;
+        Tla2024_getI2cStats(&i2c);
+        snprintf(response, MAX_RESPONSE_SIZE,
+                 "# sampler: %lld late wakeups, %lld overruns, %lld dropped samples\n"
+                 "# light source: %lld stale reads, %lld skipped readings\n"
+                 "# ADC I2C bus: %lld transactions, %lld bytes written, %lld bytes read, %lld errors\n",
+                 schedule.late_wakeups, schedule.overruns, schedule.dropped_samples,
+                 schedule.stale_reads, schedule.skipped_readings,
+                 i2c.transactions, i2c.bytes_written, i2c.bytes_read, i2c.errors);
+        send_response(response, client_addr);
+    }
+    else if (strcmp(command, "spectrum") == 0)
+    {
+        const Sampler_spectrum_t spectrum = snapshot.spectrum;
+        snprintf(response, MAX_RESPONSE_SIZE,
+                 "# dominant light frequency: %.2f Hz (%.3f V), LED set to %.0f Hz\n"
+                 "# %d-point FFT in %.0f us\n",
+                 spectrum.dominant_hz, spectrum.magnitude_volts, PwmLed_getFrequency(),
+                 spectrum.fft_size, spectrum.analysis_us);
+        send_response(response, client_addr);
+    }
+    else if (strncmp(command, "subscribe", 9) == 0 ||
+             strncmp(command, "unsubscribe", 11) == 0)
+    {
+        handle_subscription(command, pSession, client_addr);
+    }
     else if (strcmp(command, "stop") == 0)
     {
         send_response("Program terminating.\n", client_addr);
@@ -183,8 +514,7 @@ static void handle_command(const char *command, struct sockaddr_in *client_addr)
 
 static void send_response(const char *response, struct sockaddr_in *client_addr)
 {
-    sendto(sockfd, response, strlen(response), 0,
-           (struct sockaddr *)client_addr, sizeof(*client_addr));
+    queue_reply(response, strlen(response), client_addr);
 }
 
 static void send_help_message(struct sockaddr_in *client_addr)
@@ -196,6 +526,13 @@ static void send_help_message(struct sockaddr_in *client_addr)
         "length  -- get the number of samples taken in the previous second\n"
         "dips    -- get the number of dips in the previous second\n"
         "history -- get all voltage samples (V) from the previous second\n"
+        "history binary -- same, as packed int16 millivolt datagrams\n"
+        "trend <second|minute|hour> [N] -- light stats for the last N buckets\n"
+        "range <start> <count> -- samples by index, as paged int16 datagrams\n"
+        "spectrum -- get the dominant light frequency in the previous second\n"
+        "health  -- get sampler schedule, light source and ADC bus counters\n"
+        "subscribe <summary|history|dips> -- push every second / on each dip\n"
+        "unsubscribe [summary|history|dips] -- stop pushes (all if none named)\n"
         "stop    -- exit the program\n"
         "<enter> -- repeat last command\n";
 
@@ -204,31 +541,39 @@ static void send_help_message(struct sockaddr_in *client_addr)
 
 static void send_history(struct sockaddr_in *client_addr)
 {
-    int size;
-    double *history = Sampler_getHistory(&size);
-    if (!history)
-    {
-        send_response("Error getting history\n", client_addr);
-        return;
-    }
+    Sampler_history_t history;
+    Sampler_getHistorySnapshot(&history);
+    int size = history.size;
 
     // Buffer for formatting response (with room for commas and newlines)
     char response[MAX_RESPONSE_SIZE];
     int response_pos = 0;
 
-    // Format and send history in chunks of 10 numbers per line
+    // Format and send history in chunks of 10 numbers per line,
+    // converting each line's raw codes to volts in one batch
+    double voltages[HISTORY_VALUES_PER_LINE];
     for (int i = 0; i < size; i++)
     {
+        if (i % HISTORY_VALUES_PER_LINE == 0)
+        {
+            int line_size = size - i;
+            if (line_size > HISTORY_VALUES_PER_LINE)
+            {
+                line_size = HISTORY_VALUES_PER_LINE;
+            }
+            Sampler_codesToVoltages(history.codes + i, voltages, line_size);
+        }
+
         // Add number to response with exactly 3 decimal places
         int written = snprintf(response + response_pos,
                                MAX_RESPONSE_SIZE - response_pos,
-                               "%.3f", history[i]);
+                               "%.3f", voltages[i % HISTORY_VALUES_PER_LINE]);
         response_pos += written;
 
         // Add comma or newline
         if (i < size - 1)
         {
-            if ((i + 1) % 10 == 0)
+            if ((i + 1) % HISTORY_VALUES_PER_LINE == 0)
             {
                 response[response_pos++] = '\n';
             }
@@ -242,6 +587,13 @@ static void send_history(struct sockaddr_in *client_addr)
         // If buffer is getting full or this is the last number, send it
         if (response_pos > MAX_RESPONSE_SIZE - 50 || i == size - 1)
         {
+            // Don't send samples the sampler has already started reusing
+            if (!Sampler_isHistoryValid(&history))
+            {
+                send_response("\nError: history changed while sending\n", client_addr);
+                return;
+            }
+
             response[response_pos] = '\0';
             send_response(response, client_addr);
             response_pos = 0;
@@ -253,6 +605,376 @@ static void send_history(struct sockaddr_in *client_addr)
     {
         send_response("\n", client_addr);
     }
+}
+
+// Reply to "history binary": the previous second as packed millivolt
+// samples, split into as few datagrams as fit (see hal/history_packet.h).
+static void send_history_binary(struct sockaddr_in *client_addr)
+{
+    int fragment_count = build_history_packets();
+    if (fragment_count == 0)
+    {
+        send_response("Error: history changed while sending\n", client_addr);
+        return;
+    }
+    for (int fragment = 0; fragment < fragment_count; fragment++)
+    {
+        queue_reply(history_packets[fragment], history_packet_sizes[fragment], client_addr);
+    }
+}
 
-    free(history);
-}
\ No newline at end of file
+// Pack the previous second into history_packets. Returns the number of
+// fragments, or 0 if the sampler reused the samples while they were copied.
+static int build_history_packets(void)
+{
+    Sampler_history_t history;
+    Sampler_getHistorySnapshot(&history);
+    int size = history.size;
+    int fragment_count = (size + HISTORY_PACKET_MAX_SAMPLES - 1) / HISTORY_PACKET_MAX_SAMPLES;
+    if (fragment_count == 0)
+    {
+        fragment_count = 1; // An empty second is still answered
+    }
+    assert(fragment_count <= MAX_HISTORY_FRAGMENTS);
+
+    HistoryPacket_header_t header = {
+        .magic = htole32(HISTORY_PACKET_MAGIC),
+        .version = htole16(HISTORY_PACKET_VERSION),
+        .fragment_count = fragment_count,
+        .sequence = htole32(history.generation),
+        .sample_rate_hz = htole32(Sampler_getSampleRate()),
+        .first_timestamp_ns = htole64(size > 0 ? history.timestamps_ns[0] : 0),
+        .total_samples = htole16(size),
+    };
+
+    for (int fragment = 0; fragment < fragment_count; fragment++)
+    {
+        int first = fragment * HISTORY_PACKET_MAX_SAMPLES;
+        int count = size - first;
+        if (count > (int)HISTORY_PACKET_MAX_SAMPLES)
+        {
+            count = HISTORY_PACKET_MAX_SAMPLES;
+        }
+
+        uint8_t *pPacket = history_packets[fragment];
+        header.fragment_index = fragment;
+        header.first_sample = htole16(first);
+        header.num_samples = htole16(count);
+        memcpy(pPacket, &header, sizeof(header));
+
+        uint8_t *pSamples = pPacket + sizeof(header);
+        for (int i = 0; i < count; i++)
+        {
+            double millivolts = Sampler_codeToVoltage(history.codes[first + i]) * 1000;
+            uint16_t sample = htole16((uint16_t)(int16_t)lround(millivolts));
+            memcpy(pSamples + i * sizeof(sample), &sample, sizeof(sample));
+        }
+        history_packet_sizes[fragment] = sizeof(header) + count * sizeof(int16_t);
+    }
+
+    // Don't send samples the sampler has already started reusing
+    return Sampler_isHistoryValid(&history) ? fragment_count : 0;
+}
+
+// "subscribe <summary|history|dips>" / "unsubscribe [summary|history|dips]"
+static void handle_subscription(const char *command, client_session_t *pSession,
+                                struct sockaddr_in *client_addr)
+{
+    bool subscribe = (command[0] == 's');
+    const char *pArgs = command + (subscribe ? 9 : 11);
+    char kind[MAX_COMMAND_SIZE] = "";
+    if (sscanf(pArgs, " %99s", kind) != 1 && subscribe)
+    {
+        send_response("Usage: subscribe <summary|history|dips>\n", client_addr);
+        return;
+    }
+
+    unsigned mask = 0;
+    if (strcmp(kind, "summary") == 0)
+    {
+        mask = SUBSCRIBE_SUMMARY;
+    }
+    else if (strcmp(kind, "history") == 0)
+    {
+        mask = SUBSCRIBE_HISTORY;
+    }
+    else if (strcmp(kind, "dips") == 0)
+    {
+        mask = SUBSCRIBE_DIPS;
+    }
+    else if (!subscribe && kind[0] == '\0')
+    {
+        mask = SUBSCRIBE_SUMMARY | SUBSCRIBE_HISTORY | SUBSCRIBE_DIPS;
+    }
+    else
+    {
+        send_response("Error: subscribe to summary, history or dips\n", client_addr);
+        return;
+    }
+
+    char response[MAX_RESPONSE_SIZE];
+    if (subscribe)
+    {
+        pSession->subscriptions |= mask;
+        snprintf(response, MAX_RESPONSE_SIZE,
+                 "# subscribed to %s; send any command every %d s to stay subscribed\n",
+                 kind, SUBSCRIPTION_TIMEOUT_S);
+    }
+    else
+    {
+        pSession->subscriptions &= ~mask;
+        snprintf(response, MAX_RESPONSE_SIZE, "# unsubscribed from %s\n",
+                 kind[0] ? kind : "everything");
+    }
+    send_response(response, client_addr);
+}
+
+// True if the session wants `subscription` pushed, filling in its address.
+// Lapses (and tells the client) when it has been silent too long.
+static bool session_is_subscribed(client_session_t *pSession, unsigned subscription,
+                                  long long now_ns, struct sockaddr_in *pAddr)
+{
+    if (!pSession->in_use || !(pSession->subscriptions & subscription))
+    {
+        return false;
+    }
+
+    memset(pAddr, 0, sizeof(*pAddr));
+    pAddr->sin_family = AF_INET;
+    pAddr->sin_addr.s_addr = pSession->ip;
+    pAddr->sin_port = pSession->port;
+
+    if (now_ns - pSession->last_seen_ns > SUBSCRIPTION_TIMEOUT_S * NS_PER_SECOND)
+    {
+        pSession->subscriptions = 0;
+        send_response("# subscriptions expired\n", pAddr);
+        return false;
+    }
+    return true;
+}
+
+static long long get_monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+}
+
+// A second moved into history: push it to summary and history subscribers
+static void publish_history(void)
+{
+    uint64_t count;
+    if (read(history_event_fd, &count, sizeof(count)) != sizeof(count))
+    {
+        return;
+    }
+
+    Sampler_snapshot_t snapshot;
+    Sampler_getSnapshot(&snapshot);
+    char summary[MAX_RESPONSE_SIZE];
+    snprintf(summary, MAX_RESPONSE_SIZE,
+             "# second %u: samples %d avg %.3fV dips %d period ms [%.3f, %.3f] avg %.3f "
+             "flash %.2fHz\n",
+             snapshot.generation, snapshot.history_size, snapshot.average_voltage,
+             snapshot.dips, snapshot.timing.min_period_ms, snapshot.timing.max_period_ms,
+             snapshot.timing.avg_period_ms, snapshot.spectrum.dominant_hz);
+
+    int fragment_count = -1; // Built on first use
+    long long now = get_monotonic_ns();
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        struct sockaddr_in addr;
+        if (session_is_subscribed(&sessions[i], SUBSCRIBE_SUMMARY, now, &addr))
+        {
+            send_response(summary, &addr);
+        }
+        if (session_is_subscribed(&sessions[i], SUBSCRIBE_HISTORY, now, &addr))
+        {
+            if (fragment_count < 0)
+            {
+                fragment_count = build_history_packets();
+            }
+            for (int fragment = 0; fragment < fragment_count; fragment++)
+            {
+                queue_reply(history_packets[fragment], history_packet_sizes[fragment], &addr);
+            }
+        }
+    }
+}
+
+// Dips started: push to dip subscribers (several at once if they bunched up)
+static void publish_dips(void)
+{
+    uint64_t count;
+    if (read(dip_event_fd, &count, sizeof(count)) != sizeof(count))
+    {
+        return;
+    }
+
+    char message[MAX_RESPONSE_SIZE];
+    snprintf(message, MAX_RESPONSE_SIZE, "# dip: %llu new\n", (unsigned long long)count);
+
+    long long now = get_monotonic_ns();
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        struct sockaddr_in addr;
+        if (session_is_subscribed(&sessions[i], SUBSCRIBE_DIPS, now, &addr))
+        {
+            send_response(message, &addr);
+        }
+    }
+}
+
+// Reply to "trend <second|minute|hour> [N]" with one line per completed
+// bucket, oldest first: unix time, samples, min V, max V, mean V.
+static void send_trend(const char *args, struct sockaddr_in *client_addr)
+{
+    char level_name[16] = "";
+    int max_buckets = MAX_TREND_BUCKETS;
+    sscanf(args, "%15s %d", level_name, &max_buckets);
+
+    enum Sampler_resolution resolution;
+    if (strcmp(level_name, "second") == 0)
+    {
+        resolution = SAMPLER_RESOLUTION_SECOND;
+    }
+    else if (strcmp(level_name, "minute") == 0)
+    {
+        resolution = SAMPLER_RESOLUTION_MINUTE;
+    }
+    else if (strcmp(level_name, "hour") == 0)
+    {
+        resolution = SAMPLER_RESOLUTION_HOUR;
+    }
+    else
+    {
+        send_response("Usage: trend <second|minute|hour> [N]\n", client_addr);
+        return;
+    }
+
+    if (max_buckets < 1 || max_buckets > MAX_TREND_BUCKETS)
+    {
+        max_buckets = MAX_TREND_BUCKETS;
+    }
+    int count = Sampler_getTrend(resolution, trend_buckets, max_buckets);
+
+    // Bucket times are monotonic; shift them to wall-clock time for clients
+    struct timespec mono, real;
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &real);
+    long long offset_ns = (real.tv_sec - mono.tv_sec) * NS_PER_SECOND +
+                          (real.tv_nsec - mono.tv_nsec);
+
+    char response[MAX_RESPONSE_SIZE];
+    int response_pos = snprintf(response, MAX_RESPONSE_SIZE,
+                                "# trend %s: %d buckets (time, samples, min V, max V, mean V)\n",
+                                level_name, count);
+
+    for (int i = 0; i < count; i++)
+    {
+        const Sampler_bucket_t *pBucket = &trend_buckets[i];
+        response_pos += snprintf(response + response_pos,
+                                 MAX_RESPONSE_SIZE - response_pos,
+                                 "%lld, %d, %.3f, %.3f, %.3f\n",
+                                 (pBucket->start_ns + offset_ns) / NS_PER_SECOND,
+                                 pBucket->count,
+                                 pBucket->min_voltage,
+                                 pBucket->max_voltage,
+                                 pBucket->mean_voltage);
+
+        // Send whenever the packet is getting full
+        if (response_pos > MAX_RESPONSE_SIZE - 100)
+        {
+            send_response(response, client_addr);
+            response_pos = 0;
+        }
+    }
+
+    if (response_pos > 0)
+    {
+        send_response(response, client_addr);
+    }
+}
+
+// Reply to "range <start> <count>": retained samples by absolute index, as
+// RANGE_PACKET_MAX_SAMPLES-sample pages (format in hal/history_packet.h).
+// At most RANGE_MAX_PAGES pages per request, so one request can't flood
+// the link; the client resumes from the reply's end. Plain "range" reports
+// which indices are available.
+static void send_range(const char *args, struct sockaddr_in *client_addr)
+{
+    static uint16_t codes[RANGE_MAX_PAGES * RANGE_PACKET_MAX_SAMPLES];
+    static long long timestamps_ns[RANGE_MAX_PAGES * RANGE_PACKET_MAX_SAMPLES];
+
+    long long start = 0;
+    long long count = 0;
+    int num_args = sscanf(args, "%lld %lld", &start, &count);
+    if (num_args == EOF) // No arguments at all
+    {
+        Sampler_range_t range;
+        Sampler_getRange(0, codes, NULL, 0, &range);
+        char response[MAX_RESPONSE_SIZE];
+        snprintf(response, MAX_RESPONSE_SIZE,
+                 "# samples %lld to %lld retained; request up to %d per reply\n",
+                 range.oldest_index, range.end_index - 1,
+                 (int)(RANGE_MAX_PAGES * RANGE_PACKET_MAX_SAMPLES));
+        send_response(response, client_addr);
+        return;
+    }
+    if (num_args != 2 || start < 0 || count < 0)
+    {
+        send_response("Usage: range <start> <count>\n", client_addr);
+        return;
+    }
+    if (count > (long long)(RANGE_MAX_PAGES * RANGE_PACKET_MAX_SAMPLES))
+    {
+        count = RANGE_MAX_PAGES * RANGE_PACKET_MAX_SAMPLES;
+    }
+
+    Sampler_range_t range;
+    int num_samples = Sampler_getRange(start, codes, timestamps_ns, (int)count, &range);
+
+    // Pages are cut from `start`, so a re-request of a lost page gets
+    // exactly the same page back
+    int page_count = (num_samples + RANGE_PACKET_MAX_SAMPLES - 1) / RANGE_PACKET_MAX_SAMPLES;
+    if (page_count == 0)
+    {
+        page_count = 1; // Nothing retained there: still say what is
+    }
+    RangePacket_header_t header = {
+        .magic = htole32(RANGE_PACKET_MAGIC),
+        .version = htole16(RANGE_PACKET_VERSION),
+        .reply_first_index = htole64(range.first_index),
+        .reply_end_index = htole64(range.first_index + num_samples),
+        .oldest_index = htole64(range.oldest_index),
+        .end_index = htole64(range.end_index),
+        .sample_rate_hz = htole32(Sampler_getSampleRate()),
+        .page_count = htole16(page_count),
+    };
+
+    uint8_t packet[HISTORY_PACKET_MAX_SIZE];
+    for (int page = 0; page < page_count; page++)
+    {
+        int first = page * RANGE_PACKET_MAX_SAMPLES;
+        int page_samples = num_samples - first;
+        if (page_samples > (int)RANGE_PACKET_MAX_SAMPLES)
+        {
+            page_samples = RANGE_PACKET_MAX_SAMPLES;
+        }
+
+        header.num_samples = htole16(page_samples);
+        header.first_index = htole64(range.first_index + first);
+        header.first_timestamp_ns = htole64(page_samples > 0 ? timestamps_ns[first] : 0);
+        header.page_index = htole16(page);
+        memcpy(packet, &header, sizeof(header));
+
+        uint8_t *pSamples = packet + sizeof(header);
+        for (int i = 0; i < page_samples; i++)
+        {
+            double millivolts = Sampler_codeToVoltage(codes[first + i]) * 1000;
+            uint16_t sample = htole16((uint16_t)(int16_t)lround(millivolts));
+            memcpy(pSamples + i * sizeof(sample), &sample, sizeof(sample));
+        }
+        queue_reply(packet, sizeof(header) + page_samples * sizeof(int16_t), client_addr);
+    }
+}
@@ -0,0 +1,176 @@
+// Fetch the light sampler's history over UDP in binary mode, once a second.
+// Reassembles each second from its fragments and reports lost datagrams
+// and skipped seconds.
+// Usage: history_client <host> [seconds] [port]
+// Prints one summary line per second; with seconds = 0 it runs until killed.
+
+#include "hal/history_packet.h"
+#include <endian.h>
+#include <netdb.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#define DEFAULT_PORT "12345"
+#define REPLY_TIMEOUT_US 500000
+#define MAX_SAMPLES 65535
+#define MAX_FRAGMENTS 256
+
+static int16_t samples[MAX_SAMPLES];
+
+static int open_socket(const char *host, const char *port)
+{
+    struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_DGRAM};
+    struct addrinfo *pAddress;
+    int error = getaddrinfo(host, port, &hints, &pAddress);
+    if (error != 0)
+    {
+        fprintf(stderr, "Unable to resolve %s: %s\n", host, gai_strerror(error));
+        return -1;
+    }
+
+    int sockfd = socket(pAddress->ai_family, pAddress->ai_socktype, 0);
+    if (sockfd < 0 || connect(sockfd, pAddress->ai_addr, pAddress->ai_addrlen) < 0)
+    {
+        perror("Unable to open socket");
+        freeaddrinfo(pAddress);
+        return -1;
+    }
+    freeaddrinfo(pAddress);
+
+    struct timeval timeout = {0, REPLY_TIMEOUT_US};
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return sockfd;
+}
+
+// Request one second and collect its fragments until all have arrived or
+// the reply times out. Returns false if nothing usable arrived.
+static bool fetch_second(int sockfd, uint32_t *pLastSequence, bool *pHaveLast)
+{
+    const char *request = "history binary\n";
+    if (send(sockfd, request, strlen(request), 0) < 0)
+    {
+        perror("Unable to send request");
+        return false;
+    }
+
+    bool received[MAX_FRAGMENTS] = {false};
+    int num_received = 0;
+    HistoryPacket_header_t first = {0};
+
+    uint8_t packet[HISTORY_PACKET_MAX_SIZE];
+    while (num_received == 0 || num_received < first.fragment_count)
+    {
+        ssize_t length = recv(sockfd, packet, sizeof(packet), 0);
+        if (length < 0)
+        {
+            break; // Timed out: the remaining fragments were lost
+        }
+        if (length < (ssize_t)sizeof(HistoryPacket_header_t))
+        {
+            fprintf(stderr, "Text reply: %.*s", (int)length, (char *)packet);
+            continue;
+        }
+
+        HistoryPacket_header_t header;
+        memcpy(&header, packet, sizeof(header));
+        if (le32toh(header.magic) != HISTORY_PACKET_MAGIC ||
+            le16toh(header.version) != HISTORY_PACKET_VERSION)
+        {
+            fprintf(stderr, "Text reply: %.*s", (int)length, (char *)packet);
+            continue;
+        }
+
+        header.sequence = le32toh(header.sequence);
+        header.sample_rate_hz = le32toh(header.sample_rate_hz);
+        header.first_timestamp_ns = le64toh(header.first_timestamp_ns);
+        header.total_samples = le16toh(header.total_samples);
+        header.first_sample = le16toh(header.first_sample);
+        header.num_samples = le16toh(header.num_samples);
+
+        if (num_received == 0)
+        {
+            first = header;
+        }
+        else if (header.sequence != first.sequence)
+        {
+            continue; // Late fragment of an earlier second
+        }
+        if (received[header.fragment_index] ||
+            header.first_sample + header.num_samples > header.total_samples ||
+            length != (ssize_t)(sizeof(header) + header.num_samples * sizeof(int16_t)))
+        {
+            continue;
+        }
+
+        for (int i = 0; i < header.num_samples; i++)
+        {
+            uint16_t sample;
+            memcpy(&sample, packet + sizeof(header) + i * sizeof(sample), sizeof(sample));
+            samples[header.first_sample + i] = (int16_t)le16toh(sample);
+        }
+        received[header.fragment_index] = true;
+        num_received++;
+    }
+
+    if (num_received == 0)
+    {
+        printf("no reply\n");
+        return false;
+    }
+
+    // Seconds the server moved into history since our last request
+    long skipped = *pHaveLast ? (long)(first.sequence - *pLastSequence) - 1 : 0;
+    *pLastSequence = first.sequence;
+    *pHaveLast = true;
+
+    int min_mv = 0;
+    int max_mv = 0;
+    long long sum_mv = 0;
+    for (int i = 0; i < first.total_samples; i++)
+    {
+        min_mv = (i == 0 || samples[i] < min_mv) ? samples[i] : min_mv;
+        max_mv = (i == 0 || samples[i] > max_mv) ? samples[i] : max_mv;
+        sum_mv += samples[i];
+    }
+
+    printf("seq %u: %u samples @ %u Hz, t0 %.3f s, fragments %d/%d (lost %d), "
+           "skipped %ld, mV min %d max %d mean %.1f\n",
+           first.sequence, first.total_samples, first.sample_rate_hz,
+           first.first_timestamp_ns / 1e9, num_received, first.fragment_count,
+           first.fragment_count - num_received, skipped, min_mv, max_mv,
+           first.total_samples ? (double)sum_mv / first.total_samples : 0.0);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <host> [seconds] [port]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int seconds = (argc >= 3) ? atoi(argv[2]) : 10;
+    const char *port = (argc >= 4) ? argv[3] : DEFAULT_PORT;
+
+    int sockfd = open_socket(argv[1], port);
+    if (sockfd < 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    uint32_t last_sequence = 0;
+    bool have_last = false;
+    for (int i = 0; seconds == 0 || i < seconds; i++)
+    {
+        fetch_second(sockfd, &last_sequence, &have_last);
+        sleep(1);
+    }
+
+    close(sockfd);
+    return EXIT_SUCCESS;
+}
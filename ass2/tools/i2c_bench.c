@@ -0,0 +1,149 @@
+// Benchmark of I2C register reads through the HAL's I2C module.
+// Compares the old two-call register read (write() the register address,
+// then read() the data) against one combined I2c_readReg16() transaction,
+// and one burst I2c_readRegs() against separate 16-bit reads of the same
+// registers. Reports the time per read and the bus counters.
+// Needs a bus that supports plain I2C transfers, e.g. the TLA2024 on the
+// target's /dev/i2c-1 at 0x48. (The kernel's i2c-stub driver only emulates
+// SMBus commands, so it rejects both kinds of read.)
+// Usage: i2c_bench <bus> <address> [register] [iterations]
+// Defaults: register 0x00, 10000 iterations.
+
+#define _GNU_SOURCE
+#include "hal/i2c.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+
+#define DEFAULT_REGISTER 0x00
+#define DEFAULT_ITERATIONS 10000
+#define BURST_REGISTERS 2 // 16-bit registers per burst read
+
+static double now_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void print_result(const char *name, double start, int iterations,
+                         I2c_bus_t *pBus, const I2c_stats_t *pBefore)
+{
+    double us_per_read = (now_seconds() - start) * 1e6 / iterations;
+    if (!pBus)
+    {
+        printf("%-36s %8.1f us\n", name, us_per_read);
+        return;
+    }
+    I2c_stats_t after;
+    I2c_getStats(pBus, &after);
+    printf("%-36s %8.1f us  %.1f transactions, %.1f bytes each, %lld errors\n",
+           name, us_per_read,
+           (double)(after.transactions - pBefore->transactions) / iterations,
+           (double)(after.bytes_written + after.bytes_read -
+                    pBefore->bytes_written - pBefore->bytes_read) / iterations,
+           after.errors - pBefore->errors);
+}
+
+// The register read the HAL used before combined transactions: two
+// system calls, with a stop condition between the address and the data
+static void bench_two_call_reads(const char *path, uint8_t address, uint8_t reg,
+                                 int iterations)
+{
+    int file_desc = open(path, O_RDWR);
+    if (file_desc < 0 || ioctl(file_desc, I2C_SLAVE, address) < 0)
+    {
+        perror("Unable to open bus for two-call reads");
+        if (file_desc >= 0)
+        {
+            close(file_desc);
+        }
+        return;
+    }
+
+    int errors = 0;
+    double start = now_seconds();
+    for (int i = 0; i < iterations; i++)
+    {
+        uint16_t value;
+        if (write(file_desc, &reg, sizeof(reg)) != sizeof(reg) ||
+            read(file_desc, &value, sizeof(value)) != sizeof(value))
+        {
+            errors++;
+        }
+    }
+    print_result("write() + read()", start, iterations, NULL, NULL);
+    if (errors > 0)
+    {
+        printf("    %d errors\n", errors);
+    }
+    close(file_desc);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <bus> <address> [register] [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *path = argv[1];
+    uint8_t address = strtol(argv[2], NULL, 0);
+    uint8_t reg = (argc >= 4) ? strtol(argv[3], NULL, 0) : DEFAULT_REGISTER;
+    int iterations = (argc >= 5) ? atoi(argv[4]) : DEFAULT_ITERATIONS;
+    if (iterations < 1)
+    {
+        fprintf(stderr, "Need at least one iteration\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%d reads of register 0x%02x at 0x%02x on %s (time per read):\n",
+           iterations, reg, address, path);
+    bench_two_call_reads(path, address, reg, iterations);
+
+    I2c_bus_t *pBus = I2c_openBus(path);
+    if (!pBus)
+    {
+        return EXIT_FAILURE;
+    }
+
+    I2c_stats_t before;
+    I2c_getStats(pBus, &before);
+    double start = now_seconds();
+    for (int i = 0; i < iterations; i++)
+    {
+        uint16_t value;
+        I2c_readReg16(pBus, address, reg, &value);
+    }
+    print_result("I2c_readReg16()", start, iterations, pBus, &before);
+
+    // The same registers read separately, then in one burst
+    I2c_getStats(pBus, &before);
+    start = now_seconds();
+    for (int i = 0; i < iterations; i++)
+    {
+        for (int r = 0; r < BURST_REGISTERS; r++)
+        {
+            uint16_t value;
+            I2c_readReg16(pBus, address, reg + r, &value);
+        }
+    }
+    print_result("I2c_readReg16() x 2 registers", start, iterations, pBus, &before);
+
+    I2c_getStats(pBus, &before);
+    start = now_seconds();
+    for (int i = 0; i < iterations; i++)
+    {
+        uint8_t data[BURST_REGISTERS * sizeof(uint16_t)];
+        I2c_readRegs(pBus, address, reg, data, sizeof(data));
+    }
+    print_result("I2c_readRegs() burst of 2 registers", start, iterations, pBus, &before);
+
+    I2c_closeBus(pBus);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+// Benchmark of Period_markEvent() under contention.
+// Runs 1, 2, 4, ... up to the given number of threads, each marking the
+// same event as fast as it can, and reports the cost per mark and whether
+// a reader saw every mark. Marking must stay cheap with many threads, as
+// the sampling thread marks each sample while others may mark the same event.
+// Usage: period_bench [max threads] [marks per thread]
+// Defaults: 8 threads, 1000000 marks each.
+
+#define _GNU_SOURCE
+#include "hal/periodTimer.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_MAX_THREADS 8
+#define DEFAULT_MARKS 1000000
+#define MAX_THREADS 64
+
+static int num_marks;
+static atomic_bool go = false;
+static double ns_per_mark[MAX_THREADS];
+
+static double now_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void *marker_thread(void *arg)
+{
+    int id = (int)(long)arg;
+    while (!atomic_load(&go))
+    {
+    }
+    double start = now_seconds();
+    for (int i = 0; i < num_marks; i++)
+    {
+        Period_markEvent(PERIOD_EVENT_SAMPLE_LIGHT);
+    }
+    ns_per_mark[id] = (now_seconds() - start) * 1e9 / num_marks;
+    return NULL;
+}
+
+// Run one round with `num_threads` markers; returns false if marks were lost
+static bool run_round(int num_threads)
+{
+    Period_reader_t *pReader = Period_openReader(PERIOD_EVENT_SAMPLE_LIGHT);
+    pthread_t threads[MAX_THREADS];
+    atomic_store(&go, false);
+    for (long i = 0; i < num_threads; i++)
+    {
+        pthread_create(&threads[i], NULL, marker_thread, (void *)i);
+    }
+    atomic_store(&go, true);
+    double average_ns = 0;
+    for (int i = 0; i < num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+        average_ns += ns_per_mark[i] / num_threads;
+    }
+
+    Period_statistics_t stats;
+    Period_getStatistics(pReader, &stats);
+    Period_closeReader(pReader);
+
+    // Every mark ends a period, except the very first mark of the run
+    long long marks = (long long)num_threads * num_marks;
+    bool ok = stats.numSamples >= marks - 1;
+    printf("%2d threads: %6.1f ns/mark, %lld marks, reader saw %d periods%s\n",
+           num_threads, average_ns, marks, stats.numSamples, ok ? "" : "  LOST MARKS");
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    int max_threads = (argc >= 2) ? atoi(argv[1]) : DEFAULT_MAX_THREADS;
+    num_marks = (argc >= 3) ? atoi(argv[2]) : DEFAULT_MARKS;
+    if (max_threads < 1 || max_threads > MAX_THREADS || num_marks < 1)
+    {
+        fprintf(stderr, "Usage: %s [max threads, 1 to %d] [marks per thread]\n",
+                argv[0], MAX_THREADS);
+        return EXIT_FAILURE;
+    }
+
+    Period_init();
+    bool ok = true;
+    int num_threads = 1;
+    while (true)
+    {
+        ok = run_round(num_threads) && ok;
+        if (num_threads == max_threads)
+        {
+            break;
+        }
+        // Double each round, always finishing with max_threads
+        num_threads = (num_threads * 2 < max_threads) ? num_threads * 2 : max_threads;
+    }
+    Period_cleanup();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,288 @@
+// Pull the last N seconds of light samples from the light sampler over UDP,
+// using paged "range" requests. Pages that do not arrive are re-requested
+// by their cursor, so a lossy link costs retries rather than gaps.
+// Usage: range_client <host> <seconds> [output file] [drop %] [port]
+// Writes "index,millivolts" lines to the output file (if given and not "-")
+// and prints a summary. A non-zero drop % discards that share of pages on
+// receipt, to exercise the recovery path.
+
+#include "hal/history_packet.h"
+#include <endian.h>
+#include <netdb.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#define DEFAULT_PORT "12345"
+#define REPLY_TIMEOUT_US 300000
+#define MAX_ATTEMPTS 10 // Per request, before giving up on its samples
+#define MAX_PAGES 65535
+
+typedef struct {
+    long long first_index;  // Samples the client wants: [first, end)
+    long long end_index;
+    int16_t *samples;
+    bool *received;
+
+    int drop_percent;
+    long requests;
+    long pages;
+    long pages_dropped;
+} fetch_t;
+
+static int open_socket(const char *host, const char *port)
+{
+    struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_DGRAM};
+    struct addrinfo *pAddress;
+    int error = getaddrinfo(host, port, &hints, &pAddress);
+    if (error != 0)
+    {
+        fprintf(stderr, "Unable to resolve %s: %s\n", host, gai_strerror(error));
+        return -1;
+    }
+
+    int sockfd = socket(pAddress->ai_family, pAddress->ai_socktype, 0);
+    if (sockfd < 0 || connect(sockfd, pAddress->ai_addr, pAddress->ai_addrlen) < 0)
+    {
+        perror("Unable to open socket");
+        freeaddrinfo(pAddress);
+        return -1;
+    }
+    freeaddrinfo(pAddress);
+
+    struct timeval timeout = {0, REPLY_TIMEOUT_US};
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return sockfd;
+}
+
+// Send "range <start> <count>" and collect its pages until all have arrived
+// or the reply times out. Fills in the last header seen (which describes
+// the whole reply) and returns false if no page arrived.
+static bool request_range(int sockfd, fetch_t *pFetch, long long start, long long count,
+                          RangePacket_header_t *pReply)
+{
+    char request[64];
+    snprintf(request, sizeof(request), "range %lld %lld\n", start, count);
+    if (send(sockfd, request, strlen(request), 0) < 0)
+    {
+        perror("Unable to send request");
+        return false;
+    }
+    pFetch->requests++;
+
+    static bool page_seen[MAX_PAGES];
+    int num_seen = 0;
+    int page_count = 0;
+
+    uint8_t packet[HISTORY_PACKET_MAX_SIZE];
+    while (num_seen == 0 || num_seen < page_count)
+    {
+        ssize_t length = recv(sockfd, packet, sizeof(packet), 0);
+        if (length < 0)
+        {
+            break; // Timed out: the remaining pages were lost
+        }
+
+        RangePacket_header_t header;
+        if (length < (ssize_t)sizeof(header))
+        {
+            continue;
+        }
+        memcpy(&header, packet, sizeof(header));
+        if (le32toh(header.magic) != RANGE_PACKET_MAGIC ||
+            le16toh(header.version) != RANGE_PACKET_VERSION)
+        {
+            continue;
+        }
+
+        header.num_samples = le16toh(header.num_samples);
+        header.first_index = le64toh(header.first_index);
+        header.reply_first_index = le64toh(header.reply_first_index);
+        header.reply_end_index = le64toh(header.reply_end_index);
+        header.oldest_index = le64toh(header.oldest_index);
+        header.end_index = le64toh(header.end_index);
+        header.first_timestamp_ns = le64toh(header.first_timestamp_ns);
+        header.sample_rate_hz = le32toh(header.sample_rate_hz);
+        header.page_index = le16toh(header.page_index);
+        header.page_count = le16toh(header.page_count);
+
+        // Ignore late pages from an earlier request. The reply starts at
+        // `start` unless the server had already overwritten it.
+        bool starts_here = header.reply_first_index == start ||
+                           (header.reply_first_index > start &&
+                            header.reply_first_index == header.oldest_index);
+        if (!starts_here || header.reply_end_index - header.reply_first_index > count ||
+            length != (ssize_t)(sizeof(header) + header.num_samples * sizeof(int16_t)))
+        {
+            continue;
+        }
+        if (num_seen == 0)
+        {
+            page_count = header.page_count;
+            memset(page_seen, 0, page_count * sizeof(page_seen[0]));
+        }
+        if (header.page_index >= page_count || page_seen[header.page_index])
+        {
+            continue;
+        }
+        page_seen[header.page_index] = true;
+        num_seen++;
+        *pReply = header;
+
+        pFetch->pages++;
+        if (rand() % 100 < pFetch->drop_percent)
+        {
+            pFetch->pages_dropped++;
+            continue;
+        }
+
+        for (int i = 0; i < header.num_samples; i++)
+        {
+            long long index = header.first_index + i;
+            if (index < pFetch->first_index || index >= pFetch->end_index)
+            {
+                continue;
+            }
+            uint16_t sample;
+            memcpy(&sample, packet + sizeof(header) + i * sizeof(sample), sizeof(sample));
+            pFetch->samples[index - pFetch->first_index] = (int16_t)le16toh(sample);
+            pFetch->received[index - pFetch->first_index] = true;
+        }
+    }
+    return num_seen > 0;
+}
+
+// Re-request every run of missing samples in [start, end), one page at a
+// time, until they arrive or MAX_ATTEMPTS requests in a row bring nothing.
+static void fill_gaps(int sockfd, fetch_t *pFetch, long long start, long long end)
+{
+    long long index = start;
+    int attempts = 0;
+    while (index < end && attempts < MAX_ATTEMPTS)
+    {
+        if (pFetch->received[index - pFetch->first_index])
+        {
+            index++;
+            continue;
+        }
+
+        long long count = end - index;
+        if (count > (long long)RANGE_PACKET_MAX_SAMPLES)
+        {
+            count = RANGE_PACKET_MAX_SAMPLES;
+        }
+        RangePacket_header_t reply;
+        if (request_range(sockfd, pFetch, index, count, &reply) &&
+            reply.reply_first_index > index)
+        {
+            // The server no longer has these samples
+            index = reply.reply_first_index;
+            continue;
+        }
+        attempts = pFetch->received[index - pFetch->first_index] ? 0 : attempts + 1;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <host> <seconds> [output file] [drop %%] [port]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    double seconds = atof(argv[2]);
+    const char *output_path = (argc >= 4) ? argv[3] : "-";
+    fetch_t fetch = {.drop_percent = (argc >= 5) ? atoi(argv[4]) : 0};
+    const char *port = (argc >= 6) ? argv[5] : DEFAULT_PORT;
+
+    int sockfd = open_socket(argv[1], port);
+    if (sockfd < 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // An empty range tells us what the server retains
+    RangePacket_header_t info;
+    int attempts = 0;
+    while (!request_range(sockfd, &fetch, 0, 0, &info))
+    {
+        if (++attempts == MAX_ATTEMPTS)
+        {
+            fprintf(stderr, "No reply from %s\n", argv[1]);
+            return EXIT_FAILURE;
+        }
+    }
+    fetch.end_index = info.end_index;
+    fetch.first_index = info.end_index - (long long)(seconds * info.sample_rate_hz);
+    if (fetch.first_index < info.oldest_index)
+    {
+        fetch.first_index = info.oldest_index;
+    }
+    long long total = fetch.end_index - fetch.first_index;
+    fetch.samples = calloc(total > 0 ? total : 1, sizeof(int16_t));
+    fetch.received = calloc(total > 0 ? total : 1, sizeof(bool));
+    if (!fetch.samples || !fetch.received)
+    {
+        perror("Unable to allocate samples");
+        return EXIT_FAILURE;
+    }
+
+    // Walk the range a reply at a time, patching each reply's lost pages
+    // before moving on so they are fetched while the server still has them
+    long long cursor = fetch.first_index;
+    attempts = 0;
+    while (cursor < fetch.end_index && attempts < MAX_ATTEMPTS)
+    {
+        RangePacket_header_t reply;
+        if (!request_range(sockfd, &fetch, cursor, fetch.end_index - cursor, &reply))
+        {
+            attempts++;
+            continue;
+        }
+        attempts = 0;
+        if (reply.reply_end_index <= cursor)
+        {
+            break; // Nothing left on the server
+        }
+        fill_gaps(sockfd, &fetch, cursor, reply.reply_end_index);
+        cursor = reply.reply_end_index;
+    }
+
+    FILE *pOutput = (strcmp(output_path, "-") == 0) ? NULL : fopen(output_path, "w");
+    if (strcmp(output_path, "-") != 0 && !pOutput)
+    {
+        perror("Unable to open output file");
+    }
+    long long missing = 0;
+    for (long long i = 0; i < total; i++)
+    {
+        if (!fetch.received[i])
+        {
+            missing++;
+        }
+        else if (pOutput)
+        {
+            fprintf(pOutput, "%lld,%d\n", fetch.first_index + i, fetch.samples[i]);
+        }
+    }
+    if (pOutput)
+    {
+        fclose(pOutput);
+    }
+
+    printf("samples %lld..%lld (%.1f s @ %u Hz): received %lld, missing %lld; "
+           "%ld requests, %ld pages (%ld dropped)\n",
+           fetch.first_index, fetch.end_index - 1, total / (double)info.sample_rate_hz,
+           info.sample_rate_hz, total - missing, missing, fetch.requests, fetch.pages,
+           fetch.pages_dropped);
+
+    free(fetch.samples);
+    free(fetch.received);
+    close(sockfd);
+    return missing == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,99 @@
+// Convert a SampleRecorder recording into CSV, oldest sample first.
+// Usage: sample_dump <recording> [output.csv]
+// Writes to stdout when no output file is given.
+
+#include "hal/sample_recorder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int dump(FILE *pIn, FILE *pOut)
+{
+    SampleRecorder_header_t header;
+    if (fread(&header, sizeof(header), 1, pIn) != 1 ||
+        memcmp(header.magic, SAMPLE_RECORDER_MAGIC, sizeof(header.magic)) != 0)
+    {
+        fprintf(stderr, "Not a sample recording\n");
+        return EXIT_FAILURE;
+    }
+    if (header.version != SAMPLE_RECORDER_VERSION ||
+        header.record_size != sizeof(SampleRecorder_record_t))
+    {
+        fprintf(stderr, "Unsupported recording version %u\n", header.version);
+        return EXIT_FAILURE;
+    }
+
+    // Once the ring has wrapped, the oldest record is the next one to be overwritten
+    uint64_t written = atomic_load(&header.num_written);
+    uint64_t count = written;
+    uint64_t first_slot = 0;
+    if (written > header.capacity)
+    {
+        count = header.capacity;
+        first_slot = written % header.capacity;
+    }
+
+    fprintf(pOut, "index,timestamp_ns,code,voltage\n");
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint64_t slot = (first_slot + i) % header.capacity;
+        long offset = sizeof(header) + slot * sizeof(SampleRecorder_record_t);
+
+        // Only seek when wrapping back to the start of the ring
+        if (i == 0 || slot == 0)
+        {
+            fseek(pIn, offset, SEEK_SET);
+        }
+
+        SampleRecorder_record_t record;
+        if (fread(&record, sizeof(record), 1, pIn) != 1)
+        {
+            fprintf(stderr, "Recording is truncated at record %llu\n",
+                    (unsigned long long)i);
+            return EXIT_FAILURE;
+        }
+        fprintf(pOut, "%llu,%lld,%u,%.4f\n",
+                (unsigned long long)(written - count + i),
+                (long long)record.timestamp_ns,
+                record.code,
+                record.code * header.volts_per_code);
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "Usage: %s <recording> [output.csv]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *pIn = fopen(argv[1], "rb");
+    if (!pIn)
+    {
+        perror("Unable to open recording");
+        return EXIT_FAILURE;
+    }
+
+    FILE *pOut = stdout;
+    if (argc == 3)
+    {
+        pOut = fopen(argv[2], "w");
+        if (!pOut)
+        {
+            perror("Unable to open output file");
+            fclose(pIn);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int result = dump(pIn, pOut);
+
+    fclose(pIn);
+    if (pOut != stdout)
+    {
+        fclose(pOut);
+    }
+    return result;
+}
@@ -0,0 +1,122 @@
+// Host check of the whole sampling pipeline without hardware.
+// Runs the Sampler in manual mode on the synthetic light source, as fast as
+// the CPU allows, and checks every simulated second: the history holds one
+// second of samples, the dip count matches the synthetic dip rate, and the
+// timestamps are exactly one period apart. Reports the speed-up over real
+// time and exits non-zero on any mismatch.
+// Usage: sampler_check [seconds] [samples/s] [dip Hz]
+// Defaults: 100 seconds at 1000 samples/s with 7 Hz dips.
+
+#define _GNU_SOURCE
+#include "hal/light_source.h"
+#include "hal/sampler.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_SECONDS 100
+#define DEFAULT_SAMPLES_PER_SECOND 1000
+#define DEFAULT_DIP_HZ 7
+#define NOISE_VOLTS 0.01
+#define SETTLING_SECONDS 1    // The running average starts from the first sample
+#define MAX_DIP_ERROR 1       // A dip may start either side of a second boundary
+#define MAX_TIMING_ERROR_MS 1e-6
+
+static double now_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Check one completed second; returns the number of problems found
+static int check_second(int second, int samples_per_second, int dip_hz)
+{
+    int problems = 0;
+    double period_ms = 1000.0 / samples_per_second;
+
+    Sampler_history_t history;
+    Sampler_getHistorySnapshot(&history);
+    if (history.size != samples_per_second)
+    {
+        printf("second %d: %d samples, expected %d\n", second, history.size, samples_per_second);
+        problems++;
+    }
+    if (abs(history.dips - dip_hz) > MAX_DIP_ERROR)
+    {
+        printf("second %d: %d dips, expected %d\n", second, history.dips, dip_hz);
+        problems++;
+    }
+
+    const Sampler_timing_t *pTiming = &history.timing;
+    if (fabs(pTiming->avg_period_ms - period_ms) > MAX_TIMING_ERROR_MS ||
+        fabs(pTiming->min_period_ms - period_ms) > MAX_TIMING_ERROR_MS ||
+        fabs(pTiming->max_period_ms - period_ms) > MAX_TIMING_ERROR_MS ||
+        pTiming->jitter_ms > MAX_TIMING_ERROR_MS)
+    {
+        printf("second %d: periods %.6f/%.6f/%.6f ms (min/avg/max), jitter %.6f ms, expected %.6f ms\n",
+               second, pTiming->min_period_ms, pTiming->avg_period_ms,
+               pTiming->max_period_ms, pTiming->jitter_ms, period_ms);
+        problems++;
+    }
+
+    if (!Sampler_isHistoryValid(&history))
+    {
+        printf("second %d: history overwritten while checking it\n", second);
+        problems++;
+    }
+    return problems;
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = (argc >= 2) ? atoi(argv[1]) : DEFAULT_SECONDS;
+    int samples_per_second = (argc >= 3) ? atoi(argv[2]) : DEFAULT_SAMPLES_PER_SECOND;
+    int dip_hz = (argc >= 4) ? atoi(argv[3]) : DEFAULT_DIP_HZ;
+    if (seconds <= SETTLING_SECONDS || samples_per_second < 1 || dip_hz < 0)
+    {
+        fprintf(stderr, "Usage: %s [seconds > %d] [samples/s] [dip Hz]\n",
+                argv[0], SETTLING_SECONDS);
+        return EXIT_FAILURE;
+    }
+
+    LightSource_configureSynthetic(dip_hz, NOISE_VOLTS);
+    Sampler_setSource(&LightSource_synthetic);
+    Sampler_initManual(samples_per_second);
+
+    int problems = 0;
+    long long total_dips = 0;
+    double start = now_seconds();
+    for (int second = 0; second < seconds; second++)
+    {
+        Sampler_runSamples(samples_per_second);
+        Sampler_moveCurrentDataToHistory();
+        if (second >= SETTLING_SECONDS)
+        {
+            problems += check_second(second, samples_per_second, dip_hz);
+            total_dips += Sampler_getDips();
+        }
+    }
+    double elapsed = now_seconds() - start;
+
+    long long expected_samples = (long long)seconds * samples_per_second;
+    if (Sampler_getNumSamplesTaken() != expected_samples)
+    {
+        printf("%lld samples taken, expected %lld\n", Sampler_getNumSamplesTaken(), expected_samples);
+        problems++;
+    }
+    long long expected_dips = (long long)(seconds - SETTLING_SECONDS) * dip_hz;
+    if (llabs(total_dips - expected_dips) > MAX_DIP_ERROR)
+    {
+        printf("%lld dips in total, expected %lld\n", total_dips, expected_dips);
+        problems++;
+    }
+    Sampler_cleanup();
+
+    printf("%d simulated seconds (%lld samples, %lld dips) in %.3f s: %.0fx real time, %.0f samples/s\n",
+           seconds, expected_samples, total_dips, elapsed, seconds / elapsed,
+           expected_samples / elapsed);
+    printf("%s: %d problems\n", problems == 0 ? "PASS" : "FAIL", problems);
+    return problems == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,150 @@
+// Stress test of the sampling thread's schedule under reader load.
+// Runs the threaded Sampler on the synthetic light source, first alone and
+// then with reader threads calling the Sampler's getters in a tight loop,
+// and compares the sampling-period jitter of the two phases. Readers must
+// not disturb the sampling thread: the periods should look the same.
+// Usage: sampler_stress [readers] [seconds per phase] [samples/s]
+// Defaults: 4 readers for 5 seconds per phase at 1000 samples/s.
+
+#define _GNU_SOURCE
+#include "hal/light_source.h"
+#include "hal/periodTimer.h"
+#include "hal/sampler.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_READERS 4
+#define DEFAULT_SECONDS 5
+#define DEFAULT_SAMPLES_PER_SECOND 1000
+#define MAX_READERS 64
+#define DIP_HZ 7
+#define NOISE_VOLTS 0.01
+
+static atomic_bool readers_stop = false;
+static atomic_llong num_reads = 0;
+
+// Calls every kind of getter in turn, as the UDP server and display do
+static void *reader_thread(void *arg)
+{
+    (void)arg;
+    long long reads = 0;
+    while (!atomic_load_explicit(&readers_stop, memory_order_relaxed))
+    {
+        Sampler_snapshot_t snapshot;
+        Sampler_getSnapshot(&snapshot);
+
+        Sampler_history_t history;
+        Sampler_getHistorySnapshot(&history);
+        long long sum = 0;
+        for (int i = 0; i < history.size; i++)
+        {
+            sum += history.codes[i];
+        }
+        if (!Sampler_isHistoryValid(&history))
+        {
+            sum = 0;
+        }
+
+        volatile double average = Sampler_getAverageReading() + sum;
+        volatile long long taken = Sampler_getNumSamplesTaken();
+        (void)average;
+        (void)taken;
+        reads += 4;
+    }
+    atomic_fetch_add(&num_reads, reads);
+    return NULL;
+}
+
+// Run for `seconds`, moving each second into history like the app does,
+// and print the period statistics of the whole phase
+static void run_phase(const char *name, int seconds, Period_reader_t *pReader)
+{
+    Sampler_schedule_stats_t before;
+    Sampler_getScheduleStats(&before);
+    Period_statistics_t discarded;
+    Period_getStatistics(pReader, &discarded);
+
+    double worst_jitter_ms = 0;
+    double total_jitter_ms = 0;
+    for (int second = 0; second < seconds; second++)
+    {
+        struct timespec one_second = {1, 0};
+        nanosleep(&one_second, NULL);
+        Sampler_moveCurrentDataToHistory();
+
+        Sampler_timing_t timing;
+        Sampler_getTimingStats(&timing);
+        total_jitter_ms += timing.jitter_ms;
+        if (timing.jitter_ms > worst_jitter_ms)
+        {
+            worst_jitter_ms = timing.jitter_ms;
+        }
+    }
+
+    Period_statistics_t stats;
+    Period_getStatistics(pReader, &stats);
+    Sampler_schedule_stats_t after;
+    Sampler_getScheduleStats(&after);
+
+    printf("%s:\n", name);
+    printf("  periods: %d, min %.3f, avg %.3f, max %.3f ms\n",
+           stats.numSamples, stats.minPeriodInMs, stats.avgPeriodInMs, stats.maxPeriodInMs);
+    printf("  percentiles: p50 %.3f, p90 %.3f, p99 %.3f, p99.9 %.3f ms\n",
+           stats.p50PeriodInMs, stats.p90PeriodInMs, stats.p99PeriodInMs, stats.p999PeriodInMs);
+    printf("  jitter per second: avg %.4f, worst %.4f ms\n",
+           total_jitter_ms / seconds, worst_jitter_ms);
+    printf("  late wakeups %lld, overruns %lld, dropped samples %lld\n",
+           after.late_wakeups - before.late_wakeups, after.overruns - before.overruns,
+           after.dropped_samples - before.dropped_samples);
+}
+
+int main(int argc, char *argv[])
+{
+    int num_readers = (argc >= 2) ? atoi(argv[1]) : DEFAULT_READERS;
+    int seconds = (argc >= 3) ? atoi(argv[2]) : DEFAULT_SECONDS;
+    int samples_per_second = (argc >= 4) ? atoi(argv[3]) : DEFAULT_SAMPLES_PER_SECOND;
+    if (num_readers < 1 || num_readers > MAX_READERS || seconds < 1 || samples_per_second < 1)
+    {
+        fprintf(stderr, "Usage: %s [readers, 1 to %d] [seconds per phase] [samples/s]\n",
+                argv[0], MAX_READERS);
+        return EXIT_FAILURE;
+    }
+
+    Period_init();
+    LightSource_configureSynthetic(DIP_HZ, NOISE_VOLTS);
+    Sampler_setSource(&LightSource_synthetic);
+    Sampler_init(samples_per_second);
+    Period_reader_t *pReader = Period_openReader(PERIOD_EVENT_SAMPLE_LIGHT);
+
+    // Let the first, partial second pass
+    struct timespec one_second = {1, 0};
+    nanosleep(&one_second, NULL);
+    Sampler_moveCurrentDataToHistory();
+
+    run_phase("No readers", seconds, pReader);
+
+    pthread_t readers[MAX_READERS];
+    for (int i = 0; i < num_readers; i++)
+    {
+        pthread_create(&readers[i], NULL, reader_thread, NULL);
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "%d readers", num_readers);
+    run_phase(name, seconds, pReader);
+
+    atomic_store(&readers_stop, true);
+    for (int i = 0; i < num_readers; i++)
+    {
+        pthread_join(readers[i], NULL);
+    }
+    printf("  reader calls: %.0f/s\n", (double)atomic_load(&num_reads) / seconds);
+
+    Period_closeReader(pReader);
+    Sampler_cleanup();
+    Period_cleanup();
+    return EXIT_SUCCESS;
+}
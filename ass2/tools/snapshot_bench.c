@@ -0,0 +1,111 @@
+// Benchmark and consistency check of Sampler_getSnapshot().
+// Reader threads hammer Sampler_getSnapshot() while the main thread
+// publishes seconds as fast as it can, with the Sampler in manual mode on
+// the synthetic source. Every second holds the same number of samples, so
+// each snapshot must satisfy num_samples_taken == generation * samples
+// per second and history_size == samples per second; any snapshot mixing
+// two seconds is counted as torn. Reports publishes and reads per second.
+// Usage: snapshot_bench [readers] [publishes] [samples per second]
+// Defaults: 3 readers, 200000 publishes of 100 samples.
+
+#define _GNU_SOURCE
+#include "hal/light_source.h"
+#include "hal/sampler.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_READERS 3
+#define DEFAULT_PUBLISHES 200000
+#define DEFAULT_SAMPLES_PER_SECOND 100
+#define MAX_READERS 64
+
+typedef struct {
+    long long reads;
+    long long torn;
+} reader_result_t;
+
+static int samples_per_second;
+static atomic_bool readers_stop = false;
+static reader_result_t results[MAX_READERS];
+
+static double now_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void *reader_thread(void *arg)
+{
+    reader_result_t *pResult = arg;
+    while (!atomic_load_explicit(&readers_stop, memory_order_relaxed))
+    {
+        Sampler_snapshot_t snapshot;
+        Sampler_getSnapshot(&snapshot);
+        pResult->reads++;
+
+        // Nothing is published before the first second
+        if (snapshot.generation == 0)
+        {
+            continue;
+        }
+        if (snapshot.num_samples_taken != (long long)snapshot.generation * samples_per_second ||
+            snapshot.history_size != samples_per_second)
+        {
+            pResult->torn++;
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    int num_readers = (argc >= 2) ? atoi(argv[1]) : DEFAULT_READERS;
+    int num_publishes = (argc >= 3) ? atoi(argv[2]) : DEFAULT_PUBLISHES;
+    samples_per_second = (argc >= 4) ? atoi(argv[3]) : DEFAULT_SAMPLES_PER_SECOND;
+    if (num_readers < 1 || num_readers > MAX_READERS || num_publishes < 1 ||
+        samples_per_second < 1)
+    {
+        fprintf(stderr, "Usage: %s [readers, 1 to %d] [publishes] [samples per second]\n",
+                argv[0], MAX_READERS);
+        return EXIT_FAILURE;
+    }
+
+    Sampler_setSource(&LightSource_synthetic);
+    Sampler_initManual(samples_per_second);
+
+    pthread_t readers[MAX_READERS];
+    for (int i = 0; i < num_readers; i++)
+    {
+        pthread_create(&readers[i], NULL, reader_thread, &results[i]);
+    }
+
+    double start = now_seconds();
+    for (int i = 0; i < num_publishes; i++)
+    {
+        Sampler_runSamples(samples_per_second);
+        Sampler_moveCurrentDataToHistory();
+    }
+    double elapsed = now_seconds() - start;
+
+    atomic_store(&readers_stop, true);
+    long long reads = 0;
+    long long torn = 0;
+    for (int i = 0; i < num_readers; i++)
+    {
+        pthread_join(readers[i], NULL);
+        reads += results[i].reads;
+        torn += results[i].torn;
+    }
+    Sampler_cleanup();
+
+    printf("%d publishes in %.3f s: %.0f publishes/s\n",
+           num_publishes, elapsed, num_publishes / elapsed);
+    printf("%d readers: %lld snapshots, %.0f reads/s, %lld torn\n",
+           num_readers, reads, reads / elapsed, torn);
+    return torn == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
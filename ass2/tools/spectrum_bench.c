@@ -0,0 +1,146 @@
+// Benchmark of the once-a-second spectrum analysis (LightSpectrum).
+// For each sample rate, analyzes windows of synthetic light the size of
+// one second of samples (give or take one, as real seconds are) and
+// reports the distribution of the time per analysis against the 1 s
+// budget, and how often the dominant frequency matched the synthetic
+// dip rate. Run it on the board: that is where the budget matters.
+// Usage: spectrum_bench [analyses per rate] [sample rates...]
+// Defaults: 1000 analyses at 100, 500, 1000, 2000 and 3300 samples/s.
+
+#define _GNU_SOURCE
+#include "hal/light_source.h"
+#include "hal/light_spectrum.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_ANALYSES 1000
+#define BUDGET_US 1000000.0 // Analysis runs once per one-second history move
+#define MIN_SAMPLE_RATE_HZ 1
+#define MAX_SAMPLE_RATE_HZ 3300
+#define BUFFER_SECONDS 1.5 // The Sampler sizes its buffers (and the FFT) for this
+#define NS_PER_SECOND 1000000000LL
+#define NOISE_VOLTS 0.01
+#define MAX_DIP_HZ 40
+
+static const int default_rates[] = {100, 500, 1000, 2000, 3300};
+
+static long long now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+}
+
+static int compare_doubles(const void *pA, const void *pB)
+{
+    double a = *(const double *)pA;
+    double b = *(const double *)pB;
+    return (a > b) - (a < b);
+}
+
+// One second of synthetic light with dips at `dip_hz`
+static void fill_window(uint16_t *codes, int size, int sample_rate_hz, double dip_hz)
+{
+    LightSource_configureSynthetic(dip_hz, NOISE_VOLTS);
+    for (int i = 0; i < size; i++)
+    {
+        codes[i] = LightSource_synthetic.read(i * NS_PER_SECOND / sample_rate_hz);
+    }
+}
+
+// Returns false if any analysis went over budget
+static bool bench_rate(int sample_rate_hz, int num_analyses)
+{
+    int max_samples = (int)(sample_rate_hz * BUFFER_SECONDS);
+    uint16_t *codes = malloc(max_samples * sizeof(*codes));
+    double *times_us = malloc(num_analyses * sizeof(*times_us));
+    if (!codes || !times_us)
+    {
+        perror("Unable to allocate benchmark buffers");
+        exit(EXIT_FAILURE);
+    }
+    // Dips must stay well under the Nyquist rate to be found
+    int max_dip_hz = (sample_rate_hz / 4 < MAX_DIP_HZ) ? sample_rate_hz / 4 : MAX_DIP_HZ;
+    LightSpectrum_init(max_samples);
+    LightSource_synthetic.open(sample_rate_hz);
+
+    int num_matches = 0;
+    int fft_size = 0;
+    double total_us = 0;
+    for (int i = 0; i < num_analyses; i++)
+    {
+        // Vary the light and the window size like successive seconds do
+        double dip_hz = (max_dip_hz >= 1) ? 1 + i % max_dip_hz : 0;
+        int size = sample_rate_hz - 1 + i % 3;
+        if (size > max_samples)
+        {
+            size = max_samples;
+        }
+        fill_window(codes, size, sample_rate_hz, dip_hz);
+
+        LightSpectrum_peak_t peak;
+        long long start_ns = now_ns();
+        LightSpectrum_findPeak(codes, size, sample_rate_hz, &peak);
+        times_us[i] = (now_ns() - start_ns) / 1000.0;
+        total_us += times_us[i];
+
+        fft_size = peak.fft_size;
+        double bin_hz = (peak.fft_size > 0) ? (double)sample_rate_hz / peak.fft_size : 0;
+        if (dip_hz > 0 && fabs(peak.dominant_hz - dip_hz) <= bin_hz)
+        {
+            num_matches++;
+        }
+    }
+
+    qsort(times_us, num_analyses, sizeof(*times_us), compare_doubles);
+    double p50_us = times_us[num_analyses / 2];
+    double p99_us = times_us[(int)(num_analyses * 0.99)];
+    double max_us = times_us[num_analyses - 1];
+    printf("%5d samples/s  %5d-point FFT  avg %8.1f  p50 %8.1f  p99 %8.1f  max %8.1f us"
+           "  (max %.3f%% of budget)  peak found %d/%d (dips at 1 to %d Hz)\n",
+           sample_rate_hz, fft_size, total_us / num_analyses, p50_us, p99_us, max_us,
+           max_us / BUDGET_US * 100, num_matches, num_analyses, max_dip_hz);
+
+    LightSource_synthetic.close();
+    LightSpectrum_cleanup();
+    free(times_us);
+    free(codes);
+    return max_us <= BUDGET_US;
+}
+
+int main(int argc, char *argv[])
+{
+    int num_analyses = (argc >= 2) ? atoi(argv[1]) : DEFAULT_ANALYSES;
+    if (num_analyses < 1)
+    {
+        fprintf(stderr, "Usage: %s [analyses per rate] [sample rates...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+    if (argc <= 2)
+    {
+        for (size_t i = 0; i < sizeof(default_rates) / sizeof(default_rates[0]); i++)
+        {
+            ok = bench_rate(default_rates[i], num_analyses) && ok;
+        }
+    }
+    for (int i = 2; i < argc; i++)
+    {
+        int sample_rate_hz = atoi(argv[i]);
+        if (sample_rate_hz < MIN_SAMPLE_RATE_HZ || sample_rate_hz > MAX_SAMPLE_RATE_HZ)
+        {
+            fprintf(stderr, "Sample rates must be %d to %d samples/s\n",
+                    MIN_SAMPLE_RATE_HZ, MAX_SAMPLE_RATE_HZ);
+            return EXIT_FAILURE;
+        }
+        ok = bench_rate(sample_rate_hz, num_analyses) && ok;
+    }
+    printf("%s: every analysis %s the 1 s budget\n", ok ? "PASS" : "FAIL",
+           ok ? "fit in" : "did not fit in");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,102 @@
+// Benchmark of the ways to timestamp an event.
+// Times CycleClock_now() against the clock_gettime() calls it replaced
+// (CLOCK_MONOTONIC, and CLOCK_BOOTTIME, which Period_markEvent() used to
+// read), plus a whole Period_markEvent(), and checks that converted
+// CycleClock readings agree with CLOCK_MONOTONIC.
+// Usage: timestamp_bench [iterations]
+// Default: 10000000 iterations of each.
+
+#define _GNU_SOURCE
+#include "hal/cycle_clock.h"
+#include "hal/periodTimer.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_ITERATIONS 10000000
+#define NS_PER_SECOND 1000000000LL
+#define NUM_AGREEMENT_CHECKS 1000
+
+static long long read_clock_ns(clockid_t clock)
+{
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+}
+
+// Keeps the compiler from dropping the timed reads
+static volatile uint64_t sink;
+
+static void print_cost(const char *name, long long start_ns, int iterations)
+{
+    long long elapsed_ns = read_clock_ns(CLOCK_MONOTONIC) - start_ns;
+    printf("%-30s %6.1f ns\n", name, (double)elapsed_ns / iterations);
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = (argc >= 2) ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    if (iterations < 1)
+    {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    CycleClock_init();
+    Period_init();
+
+    long long start_ns = read_clock_ns(CLOCK_MONOTONIC);
+    for (int i = 0; i < iterations; i++)
+    {
+        sink += read_clock_ns(CLOCK_BOOTTIME);
+    }
+    print_cost("clock_gettime(CLOCK_BOOTTIME)", start_ns, iterations);
+
+    start_ns = read_clock_ns(CLOCK_MONOTONIC);
+    for (int i = 0; i < iterations; i++)
+    {
+        sink += read_clock_ns(CLOCK_MONOTONIC);
+    }
+    print_cost("clock_gettime(CLOCK_MONOTONIC)", start_ns, iterations);
+
+    start_ns = read_clock_ns(CLOCK_MONOTONIC);
+    for (int i = 0; i < iterations; i++)
+    {
+        sink += CycleClock_now();
+    }
+    print_cost("CycleClock_now()", start_ns, iterations);
+
+    start_ns = read_clock_ns(CLOCK_MONOTONIC);
+    for (int i = 0; i < iterations; i++)
+    {
+        Period_markEvent(PERIOD_EVENT_SAMPLE_LIGHT);
+    }
+    print_cost("Period_markEvent()", start_ns, iterations);
+
+    // Converted readings should land between the clock reads around them
+    long long worst_error_ns = 0;
+    for (int i = 0; i < NUM_AGREEMENT_CHECKS; i++)
+    {
+        long long before_ns = read_clock_ns(CLOCK_MONOTONIC);
+        long long converted_ns = CycleClock_toMonotonicNs(CycleClock_now());
+        long long after_ns = read_clock_ns(CLOCK_MONOTONIC);
+        long long error_ns = 0;
+        if (converted_ns < before_ns)
+        {
+            error_ns = before_ns - converted_ns;
+        }
+        else if (converted_ns > after_ns)
+        {
+            error_ns = converted_ns - after_ns;
+        }
+        if (error_ns > worst_error_ns)
+        {
+            worst_error_ns = error_ns;
+        }
+    }
+    printf("CycleClock: %.4f ns/tick, converted readings within %lld ns of CLOCK_MONOTONIC\n",
+           CycleClock_nsPerTick(), worst_error_ns);
+
+    Period_cleanup();
+    return EXIT_SUCCESS;
+}
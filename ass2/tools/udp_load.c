@@ -0,0 +1,133 @@
+// Load generator for the light sampler's UDP server.
+// Simulates many clients, each with its own socket and one request in
+// flight at a time, and reports the replies per second the server sustains.
+// Usage: udp_load <host> [clients] [seconds] [command] [port]
+// Defaults: 100 clients for 5 seconds sending "count" to port 12345.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#define DEFAULT_PORT "12345"
+#define DEFAULT_CLIENTS 100
+#define DEFAULT_SECONDS 5
+#define MAX_REPLY_SIZE 1500
+#define RESEND_TIMEOUT_MS 200 // A client whose reply was lost asks again
+
+static double now_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void send_request(int sockfd, const char *command)
+{
+    if (send(sockfd, command, strlen(command), 0) < 0 && errno != EAGAIN)
+    {
+        perror("Unable to send request");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <host> [clients] [seconds] [command] [port]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int num_clients = (argc >= 3) ? atoi(argv[2]) : DEFAULT_CLIENTS;
+    int seconds = (argc >= 4) ? atoi(argv[3]) : DEFAULT_SECONDS;
+    const char *command = (argc >= 5) ? argv[4] : "count";
+    const char *port = (argc >= 6) ? argv[5] : DEFAULT_PORT;
+    if (num_clients < 1 || seconds < 1)
+    {
+        fprintf(stderr, "Need at least one client and one second\n");
+        return EXIT_FAILURE;
+    }
+
+    struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_DGRAM};
+    struct addrinfo *pAddress;
+    int error = getaddrinfo(argv[1], port, &hints, &pAddress);
+    if (error != 0)
+    {
+        fprintf(stderr, "Unable to resolve %s: %s\n", argv[1], gai_strerror(error));
+        return EXIT_FAILURE;
+    }
+
+    // One connected, non-blocking socket (so one source port) per client
+    int epoll_fd = epoll_create1(0);
+    int *sockets = malloc(num_clients * sizeof(int));
+    if (epoll_fd < 0 || !sockets)
+    {
+        perror("Unable to set up clients");
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < num_clients; i++)
+    {
+        sockets[i] = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        if (sockets[i] < 0 || connect(sockets[i], pAddress->ai_addr, pAddress->ai_addrlen) < 0)
+        {
+            perror("Unable to open client socket");
+            return EXIT_FAILURE;
+        }
+        struct epoll_event event = {.events = EPOLLIN, .data.u32 = i};
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sockets[i], &event);
+    }
+    freeaddrinfo(pAddress);
+
+    for (int i = 0; i < num_clients; i++)
+    {
+        send_request(sockets[i], command);
+    }
+
+    long long replies = 0;
+    long long timeouts = 0;
+    double start = now_seconds();
+    double end = start + seconds;
+    while (now_seconds() < end)
+    {
+        struct epoll_event events[64];
+        int count = epoll_wait(epoll_fd, events, 64, RESEND_TIMEOUT_MS);
+        if (count == 0)
+        {
+            // Nothing came back in time: every client asks again
+            timeouts++;
+            for (int i = 0; i < num_clients; i++)
+            {
+                send_request(sockets[i], command);
+            }
+            continue;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            int sockfd = sockets[events[i].data.u32];
+            char reply[MAX_REPLY_SIZE];
+            while (recv(sockfd, reply, sizeof(reply), 0) > 0)
+            {
+                replies++;
+            }
+            send_request(sockfd, command);
+        }
+    }
+    double elapsed = now_seconds() - start;
+
+    printf("%d clients, '%s': %lld replies in %.2f s = %.0f replies/s (%lld stalls)\n",
+           num_clients, command, replies, elapsed, replies / elapsed, timeouts);
+
+    for (int i = 0; i < num_clients; i++)
+    {
+        close(sockets[i]);
+    }
+    free(sockets);
+    close(epoll_fd);
+    return EXIT_SUCCESS;
+}
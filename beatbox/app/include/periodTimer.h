@@ -9,14 +9,15 @@
 //  2. Call Period_markEvent() periodically to mark each
 //     occurance of the event. For example, call this function
 //     each time you sample the A2D.
-//  3. Call getStatisticsAndClear() to get the statistics for
-//     an event of interest. Calling this will clear the 
-//     data collected for this event (but not others).
+//  3. Open a reader with Period_openReader() for each consumer of
+//     an event's statistics, and call Period_getStatistics() on it
+//     to get the statistics since that reader's last call.
 //     For example, call this function once a second to get timing
-//     information to print to the screen.
-
-// Maximum number of timestamps to record for a given event.
-#define MAX_EVENT_TIMESTAMPS (1024*4)
+//     information to print to the screen. Readers are independent:
+//     one reading never clears another's data.
+// Periods between marks are kept in a fixed-size histogram per event
+// rather than as timestamps, so there is no limit on how many events
+// can be marked between calls, and percentiles are available.
 
 enum Period_whichEvent {
     PERIOD_EVENT_SAMPLE_LIGHT,
@@ -27,29 +28,45 @@ enum Period_whichEvent {
 
 typedef struct {
     int numSamples;
+    // Percentiles come from the histogram: within about 3% of the true
+    // value. The average is exact, and so are the min and max unless the
+    // window holds more than 4096 periods, when they also come from the
+    // histogram.
     double minPeriodInMs;
     double maxPeriodInMs;
     double avgPeriodInMs;
+    double p50PeriodInMs;
+    double p90PeriodInMs;
+    double p99PeriodInMs;
+    double p999PeriodInMs;
+    int numAboveThreshold; // Periods longer than Period_setThreshold()
 } Period_statistics_t;
 
 // Initialize/cleanup the module's data structures.
 void Period_init(void);
 void Period_cleanup(void);
 
-// Record the current time as a timestamp for the 
-// indicated event. This allows later calls to 
-// Period_getStatisticsAndClear() to access these timestamps
-// and compute the timing statistics for this periodic event.
+// Count periods of `whichEvent` longer than `thresholdInMs`
+// (in numAboveThreshold). 0, the default, counts none.
+void Period_setThreshold(enum Period_whichEvent whichEvent, double thresholdInMs);
+
+// Record the period since the previous mark of the indicated
+// event. Lock-free, so any number of threads may mark events
+// at once. Every open reader of the event sees the period in
+// its next Period_getStatistics().
 void Period_markEvent(enum Period_whichEvent whichEvent);
 
-// Fill the `pStats` struct, which must be allocated by the calling
-// code, with the statistics about the periodic event `whichEvent`.
-// This function is threadsafe, and may be called by any thread.
-// Calling this function will, after it computes the timing
-// statistics, clear the data stored for this event.
-void Period_getStatisticsAndClear(
-    enum Period_whichEvent whichEvent,
-    Period_statistics_t *pStats
-);
+// A consumer's own window onto an event's statistics.
+typedef struct Period_reader Period_reader_t;
+
+// Open a reader whose first window starts now. Close it when done.
+// Any number of readers may be open; they add no cost to marking.
+Period_reader_t *Period_openReader(enum Period_whichEvent whichEvent);
+void Period_closeReader(Period_reader_t *pReader);
+
+// Fill `pStats` with the statistics for the reader's event since the
+// reader's last call (or since it was opened). A reader must only be
+// used by one thread at a time.
+void Period_getStatistics(Period_reader_t *pReader, Period_statistics_t *pStats);
 
 #endif
\ No newline at end of file
@@ -8,6 +8,8 @@
 
 #include "beatPlayer.h"
 #include "drumSounds.h"
+#include "hal/metrics.h"
+#include "hal/trace.h"
 
 static BeatMode_t currentMode = BEAT_MODE_NONE;
 
@@ -21,6 +23,12 @@ static bool threadCreated = false;
 // Mutex to protect shared variables
 static pthread_mutex_t beatMutex = PTHREAD_MUTEX_INITIALIZER;
 
+// Health metrics, exported through the metrics registry
+static Metrics_metric_t *pHalfBeats;
+static Metrics_metric_t *pTempo;
+static Metrics_metric_t *pModeLevel;
+static Metrics_metric_t *pLatenessUs;
+
 // Forward declarations
 static void *beatThread(void *arg);
 static void playRockBeat(int beatCount);
@@ -30,6 +38,14 @@ static long long calculateHalfBeatTimeMs(int bpm);
 // Initialize the beat player
 void BeatPlayer_init(void)
 {
+    pHalfBeats = Metrics_registerCounter("beat.half_beats");
+    pTempo = Metrics_registerGauge("beat.tempo_bpm");
+    pModeLevel = Metrics_registerGauge("beat.mode");
+    pLatenessUs = Metrics_registerHistogram("beat.lateness_us");
+    Metrics_set(pTempo, DEFAULT_BPM);
+    Metrics_set(pModeLevel, BEAT_MODE_NONE);
+    CycleClock_init();
+
     pthread_mutex_lock(&beatMutex);
     currentMode = BEAT_MODE_NONE;
     currentBPM = DEFAULT_BPM;
@@ -95,6 +111,7 @@ bool BeatPlayer_setMode(BeatMode_t newMode)
     pthread_mutex_lock(&beatMutex);
     currentMode = newMode;
     pthread_mutex_unlock(&beatMutex);
+    Metrics_set(pModeLevel, newMode);
 
     return true;
 }
@@ -116,6 +133,7 @@ bool BeatPlayer_setTempo(int newBPM)
     pthread_mutex_lock(&beatMutex);
     currentBPM = newBPM;
     pthread_mutex_unlock(&beatMutex);
+    Metrics_set(pTempo, newBPM);
 
     return true;
 }
@@ -136,6 +154,7 @@ bool BeatPlayer_isPlaying(void)
 static void *beatThread(void *arg)
 {
     (void)arg; 
+    Trace_setThreadName("beat");
 
     int beatCount = 0;
 
@@ -155,6 +174,8 @@ static void *beatThread(void *arg)
         }
 
         // Play the appropriate beat pattern based on the current mode
+        Trace_instant("half beat");
+        Metrics_add(pHalfBeats, 1);
         switch (mode)
         {
         case BEAT_MODE_NONE:
@@ -175,8 +196,11 @@ static void *beatThread(void *arg)
         // Calculate sleep time for half a beat
         long long sleepTimeMs = calculateHalfBeatTimeMs(bpm);
 
-        // Sleep for half a beat
+        // Sleep for half a beat, noting how far past it we wake
+        uint64_t sleepStart = CycleClock_now();
         usleep(sleepTimeMs * 1000); 
+        double sleptNs = CycleClock_ticksToNs(CycleClock_now() - sleepStart);
+        Metrics_observe(pLatenessUs, (sleptNs - sleepTimeMs * 1000000.0) / 1000);
 
         // Increment beat count 
         beatCount = (beatCount + 1) % 8;
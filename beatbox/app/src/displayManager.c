@@ -7,10 +7,16 @@
 #include "periodTimer.h"
 #include <stdio.h>
 
+// Our own windows on the timing stats (the terminal reads them too)
+static Period_reader_t *pAudioReader = NULL;
+static Period_reader_t *pAccelReader = NULL;
+
 // Initialize the display manager
 void DisplayManager_init(void)
 {
     LcdDisplay_init();
+    pAudioReader = Period_openReader(PERIOD_EVENT_AUDIO);
+    pAccelReader = Period_openReader(PERIOD_EVENT_ACCEL);
     printf("Display manager initialized\n");
 }
 
@@ -18,6 +24,23 @@ void DisplayManager_init(void)
 void DisplayManager_cleanup(void)
 {
     LcdDisplay_cleanup();
+    Period_closeReader(pAudioReader);
+    Period_closeReader(pAccelReader);
+    pAudioReader = NULL;
+    pAccelReader = NULL;
+}
+
+// Copy the timing statistics the LCD shows
+static void to_lcd_timing(const Period_statistics_t *pStats, LcdDisplay_timing_t *pTiming)
+{
+    pTiming->minMs = pStats->minPeriodInMs;
+    pTiming->maxMs = pStats->maxPeriodInMs;
+    pTiming->avgMs = pStats->avgPeriodInMs;
+    pTiming->p50Ms = pStats->p50PeriodInMs;
+    pTiming->p90Ms = pStats->p90PeriodInMs;
+    pTiming->p99Ms = pStats->p99PeriodInMs;
+    pTiming->p999Ms = pStats->p999PeriodInMs;
+    pTiming->numLate = pStats->numAboveThreshold;
 }
 
 // Update the LCD display with current system information
@@ -30,11 +53,11 @@ void DisplayManager_updateDisplay(void)
 
     // Get audio statistics
     Period_statistics_t audioStats;
-    Period_getStatisticsAndClear(PERIOD_EVENT_AUDIO, &audioStats);
+    Period_getStatistics(pAudioReader, &audioStats);
 
     // Get accelerometer statistics
     Period_statistics_t accelStats;
-    Period_getStatisticsAndClear(PERIOD_EVENT_ACCEL, &accelStats);
+    Period_getStatistics(pAccelReader, &accelStats);
 
     // Get beat mode name
     const char *modeName;
@@ -56,6 +79,9 @@ void DisplayManager_updateDisplay(void)
 
     // Update LCD with current status for all screens
     LcdDisplay_updateStatus(modeName, volume, tempo);
-    LcdDisplay_updateAudioTiming(audioStats.minPeriodInMs, audioStats.maxPeriodInMs, audioStats.avgPeriodInMs);
-    LcdDisplay_updateAccelTiming(accelStats.minPeriodInMs, accelStats.maxPeriodInMs, accelStats.avgPeriodInMs);
+    LcdDisplay_timing_t timing;
+    to_lcd_timing(&audioStats, &timing);
+    LcdDisplay_updateAudioTiming(&timing);
+    to_lcd_timing(&accelStats, &timing);
+    LcdDisplay_updateAccelTiming(&timing);
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "hal/joystick.h"
 #include "hal/audioMixer.h"
 #include "hal/lcdDisplay.h"
+#include "hal/trace.h"
 
 #include <stdbool.h>
 #include <stdio.h>
@@ -31,6 +32,7 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 static void *joystick_thread_function(void *arg)
 {
     (void)arg; 
+    Trace_setThreadName("input handler");
 
     printf("Joystick thread started\n");
 
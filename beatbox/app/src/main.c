@@ -23,6 +23,8 @@
 #include "hal/rotaryEncoder.h"
 #include "hal/buttonStateMachine.h"
 #include "hal/gpio.h"
+#include "hal/metrics.h"
+#include "hal/trace.h"
 #include "drumSounds.h"
 #include "beatPlayer.h"
 #include "terminalDisplay.h"
@@ -32,6 +34,17 @@
 #include "udpServer.h"
 #include "accelerometer.h"
 
+// Main loop period (it also polls the accelerometer)
+#define MAIN_LOOP_PERIOD_MS 50
+
+// A period this much longer than expected counts as late in the timing stats
+#define LATE_PERIOD_FACTOR 1.5
+
+// Where SIGUSR1 or the UDP "trace dump" command writes the timeline. Set
+// BEATBOX_TRACE in the environment to record from start-up; otherwise
+// recording starts with the UDP "trace on" command.
+#define TRACE_DUMP_PATH "/tmp/beatbox-trace.json"
+
 // Flag to indicate if the application should continue running
 volatile bool isRunning = true;
 
@@ -64,9 +77,14 @@ int main(void)
     BeatMode_t lastEncoderMode = BEAT_MODE_ROCK;
 
     // Initialize components in correct order
+    Trace_init(TRACE_DUMP_PATH, getenv("BEATBOX_TRACE") != NULL);
+    Trace_setThreadName("main");
+    Metrics_init();
     Gpio_initialize();
     Period_init();
     AudioMixer_init();
+    Period_setThreshold(PERIOD_EVENT_AUDIO, LATE_PERIOD_FACTOR * AudioMixer_getBufferPeriodMs());
+    Period_setThreshold(PERIOD_EVENT_ACCEL, LATE_PERIOD_FACTOR * MAIN_LOOP_PERIOD_MS);
     DrumSounds_init();
     BeatPlayer_init();
     DisplayManager_init();
@@ -153,7 +171,7 @@ int main(void)
             lastUpdateTime = currentTime;
         }
 
-        usleep(50000); 
+        usleep(MAIN_LOOP_PERIOD_MS * 1000);
 
         // Check if the application has been running for too long
         time_t current_time = time(NULL);
@@ -182,6 +200,8 @@ int main(void)
     AudioMixer_cleanup();
     AccelerometerApp_cleanup();
     Gpio_cleanup();
+    Metrics_cleanup();
+    Trace_cleanup();
 
     printf("\033[0m"); 
     printf("\nBeatBox Application terminated.\n");
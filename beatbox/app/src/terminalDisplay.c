@@ -3,6 +3,7 @@
 #include "terminalDisplay.h"
 #include "periodTimer.h"
 #include "hal/audioMixer.h"
+#include "hal/trace.h"
 #include "beatPlayer.h"
 
 #include <stdio.h>
@@ -24,6 +25,10 @@ static volatile bool isShuttingDown = false;
 static void *displayThread(void *arg);
 static void updateConsoleOutput(void);
 
+// This thread's own windows on the timing stats (the LCD reads them too)
+static Period_reader_t *pAudioReader = NULL;
+static Period_reader_t *pAccelReader = NULL;
+
 // Register with the app-wide shutdown flag
 void TerminalDisplay_registerShutdown(volatile bool *appIsRunning)
 {
@@ -34,6 +39,9 @@ void TerminalDisplay_registerShutdown(volatile bool *appIsRunning)
 static void *displayThread(void *arg)
 {
     (void)arg;
+    Trace_setThreadName("terminal");
+    pAudioReader = Period_openReader(PERIOD_EVENT_AUDIO);
+    pAccelReader = Period_openReader(PERIOD_EVENT_ACCEL);
 
     // Thread timing variables
     struct timespec lastConsoleUpdate;
@@ -58,6 +66,8 @@ static void *displayThread(void *arg)
         usleep(10000);
     }
 
+    Period_closeReader(pAudioReader);
+    Period_closeReader(pAccelReader);
     Period_cleanup();
 
     printf("Terminal display thread exited\n");
@@ -74,11 +84,11 @@ static void updateConsoleOutput(void)
 
     // Get audio statistics
     Period_statistics_t audioStats;
-    Period_getStatisticsAndClear(PERIOD_EVENT_AUDIO, &audioStats);
+    Period_getStatistics(pAudioReader, &audioStats);
 
     // Get accelerometer statistics
     Period_statistics_t accelStats;
-    Period_getStatisticsAndClear(PERIOD_EVENT_ACCEL, &accelStats);
+    Period_getStatistics(pAccelReader, &accelStats);
 
     // Get current beat mode, tempo, and volume
     BeatMode_t beatMode = BeatPlayer_getMode();
@@ -102,6 +112,18 @@ static void updateConsoleOutput(void)
            accelStats.maxPeriodInMs,
            accelStats.avgPeriodInMs,
            accelStats.numSamples);
+    printf("  Audio p50/90/99/99.9 %.3f/%.3f/%.3f/%.3f late %d"
+           "  Accel p50/90/99/99.9 %.3f/%.3f/%.3f/%.3f late %d\n",
+           audioStats.p50PeriodInMs,
+           audioStats.p90PeriodInMs,
+           audioStats.p99PeriodInMs,
+           audioStats.p999PeriodInMs,
+           audioStats.numAboveThreshold,
+           accelStats.p50PeriodInMs,
+           accelStats.p90PeriodInMs,
+           accelStats.p99PeriodInMs,
+           accelStats.p999PeriodInMs,
+           accelStats.numAboveThreshold);
 
     fflush(stdout);
 }
@@ -4,6 +4,8 @@
 #include "beatPlayer.h"
 #include "hal/audioMixer.h"
 #include "hal/rotaryEncoder.h"
+#include "hal/metrics.h"
+#include "hal/trace.h"
 #include "drumSounds.h"
 
 #include <stdio.h>
@@ -29,6 +31,12 @@ static int socketFd = -1;
 // For signal handling
 static struct sigaction old_sa;
 
+// Health metrics, exported through the metrics registry
+static Metrics_metric_t *pCommands;
+static Metrics_metric_t *pUnknownCommands;
+static Metrics_metric_t *pReceiveErrors;
+static Metrics_metric_t *pCommandTimeUs;
+
 static void *serverThread(void *arg);
 static void processCommand(const char *command, struct sockaddr_in *clientAddr, socklen_t addrLen);
 
@@ -64,6 +72,12 @@ void UdpServer_init(void)
         return;
     }
 
+    pCommands = Metrics_registerCounter("udp.commands");
+    pUnknownCommands = Metrics_registerCounter("udp.unknown_commands");
+    pReceiveErrors = Metrics_registerCounter("udp.receive_errors");
+    pCommandTimeUs = Metrics_registerHistogram("udp.command_time_us");
+    CycleClock_init();
+
     struct sigaction sa;
     memset(&sa, 0, sizeof(sa));
     sa.sa_handler = udpSignalHandler;
@@ -226,6 +240,24 @@ static void processCommand(const char *command, struct sockaddr_in *clientAddr,
             snprintf(response, MAX_BUFFER_SIZE, "ERROR: Unknown drum sound");
         }
     }
+    else if (strcmp(cmd, "trace") == 0 && param != NULL)
+    {
+        // trace on|off|dump: control the timeline recorder
+        if (strcmp(param, "on") == 0 || strcmp(param, "off") == 0)
+        {
+            Trace_setEnabled(strcmp(param, "on") == 0);
+            snprintf(response, MAX_BUFFER_SIZE, "OK");
+        }
+        else if (strcmp(param, "dump") == 0)
+        {
+            Trace_requestDump();
+            snprintf(response, MAX_BUFFER_SIZE, "OK");
+        }
+        else
+        {
+            snprintf(response, MAX_BUFFER_SIZE, "ERROR: Unknown trace action");
+        }
+    }
     else if (strcmp(cmd, "shutdown") == 0 || strcmp(cmd, "stop") == 0)
     {
         shouldStopApplication = true;
@@ -237,6 +269,7 @@ static void processCommand(const char *command, struct sockaddr_in *clientAddr,
     }
     else
     {
+        Metrics_add(pUnknownCommands, 1);
         char cmdShort[20];
         strncpy(cmdShort, cmd, sizeof(cmdShort) - 1);
         cmdShort[sizeof(cmdShort) - 1] = '\0';
@@ -255,6 +288,7 @@ static void *serverThread(void *arg)
 {
     // Suppress unused parameter warning
     (void)arg;
+    Trace_setThreadName("udp server");
 
     struct sockaddr_in serverAddr, clientAddr;
     socklen_t addrLen = sizeof(clientAddr);
@@ -306,6 +340,7 @@ static void *serverThread(void *arg)
 
         if (numBytes < 0)
         {
+            Metrics_add(pReceiveErrors, 1);
             if (isRunning)
             {
                 perror("Error receiving UDP packet");
@@ -317,7 +352,13 @@ static void *serverThread(void *arg)
         buffer[numBytes] = '\0';
 
         // Process the command
+        uint64_t span = Trace_beginSpan();
+        uint64_t commandStart = CycleClock_now();
         processCommand(buffer, &clientAddr, addrLen);
+        Metrics_add(pCommands, 1);
+        Metrics_observe(pCommandTimeUs,
+                        CycleClock_ticksToNs(CycleClock_now() - commandStart) / 1000);
+        Trace_endSpan("processCommand", span);
     }
 
     return NULL;
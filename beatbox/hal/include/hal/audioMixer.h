@@ -30,4 +30,8 @@ void AudioMixer_queueSound(wavedata_t *pSound);
 int  AudioMixer_getVolume();
 void AudioMixer_setVolume(int newVolume);
 
+// Time between playback buffers (each one is an audio event), in ms.
+// Valid after init().
+double AudioMixer_getBufferPeriodMs(void);
+
 #endif 
\ No newline at end of file
@@ -0,0 +1,49 @@
+// Module for register access to I2C devices through the Linux i2c-dev
+// interface.
+//
+// A bus is opened once and shared by every device on it. Each register
+// read is a single combined transaction (address write, repeated start,
+// data read) issued with one ioctl(I2C_RDWR), and consecutive registers
+// can be read in one burst. Every bus keeps counters of the transfers
+// made on it, exported as the "i2c.<bus>." metrics (e.g.
+// "i2c.i2c-1.transactions"; see hal/metrics.h), so Metrics_init() must be
+// called before any open.
+#ifndef _I2C_H_
+#define _I2C_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct I2c_bus I2c_bus_t;
+
+// Totals since the bus was opened
+typedef struct {
+    long long transactions; // System calls made (each is one bus transaction)
+    long long bytes_written; // Including register addresses
+    long long bytes_read;
+    long long errors;
+} I2c_stats_t;
+
+// Open a bus, e.g. "/dev/i2c-1". Opening a bus that is already open shares
+// it; each open must be matched by a close. Returns NULL on failure.
+I2c_bus_t *I2c_openBus(const char *path);
+void I2c_closeBus(I2c_bus_t *pBus);
+
+// Write a register on the device at `address`. 16-bit values are sent
+// low byte first. Return false on failure.
+bool I2c_writeReg8(I2c_bus_t *pBus, uint8_t address, uint8_t reg, uint8_t value);
+bool I2c_writeReg16(I2c_bus_t *pBus, uint8_t address, uint8_t reg, uint16_t value);
+
+// Read `length` bytes starting at register `reg`, in one transaction.
+// (Some devices need a flag in `reg` to auto-increment across registers.)
+// Returns false on failure.
+bool I2c_readRegs(I2c_bus_t *pBus, uint8_t address, uint8_t reg,
+                  uint8_t *pData, size_t length);
+
+// Read a 16-bit register; the two bytes are stored in the order received.
+bool I2c_readReg16(I2c_bus_t *pBus, uint8_t address, uint8_t reg, uint16_t *pValue);
+
+void I2c_getStats(I2c_bus_t *pBus, I2c_stats_t *pStats);
+
+#endif
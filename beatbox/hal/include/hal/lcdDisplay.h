@@ -12,6 +12,18 @@ typedef enum {
     LCD_SCREEN_COUNT           // Total number of screens
 } LcdScreenType;
 
+// Timing statistics for one of the timing screens, in ms
+typedef struct {
+    double minMs;
+    double maxMs;
+    double avgMs;
+    double p50Ms;
+    double p90Ms;
+    double p99Ms;
+    double p999Ms;
+    int numLate; // Periods over the event's threshold
+} LcdDisplay_timing_t;
+
 void LcdDisplay_init(void);
 
 void LcdDisplay_cleanup(void);
@@ -22,9 +34,9 @@ LcdScreenType LcdDisplay_getCurrentScreen(void);
 
 void LcdDisplay_updateStatus(const char* beatName, int volume, int bpm);
 
-void LcdDisplay_updateAudioTiming(double min, double max, double avg);
+void LcdDisplay_updateAudioTiming(const LcdDisplay_timing_t *pTiming);
 
-void LcdDisplay_updateAccelTiming(double min, double max, double avg);
+void LcdDisplay_updateAccelTiming(const LcdDisplay_timing_t *pTiming);
 
 void LcdDisplay_refresh(void);
 
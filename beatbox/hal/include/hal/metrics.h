@@ -0,0 +1,104 @@
+// Module holding the process's runtime health numbers: counters, gauges
+// and histograms that modules register at init and then update from
+// their hot paths with a single relaxed atomic operation (no locks, no
+// system calls).
+//
+// The metrics live in the POSIX shared-memory segment METRICS_SHM_NAME,
+// laid out as a Metrics_segment_t, so tools (see tools/statsdump.c) can
+// map it read-only and watch live values. Any change to the layout must
+// bump METRICS_VERSION.
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define METRICS_SHM_NAME "/beatbox-metrics"
+#define METRICS_MAGIC 0x5358544d // "MTXS" in little-endian memory
+#define METRICS_VERSION 1
+
+#define METRICS_MAX_ENTRIES 64
+#define METRICS_NAME_LENGTH 48
+// Histogram bucket 0 counts values <= 0; bucket i counts values in
+// [2^(i-1), 2^i); the last bucket also takes everything larger
+#define METRICS_HISTOGRAM_BUCKETS 32
+
+enum Metrics_type {
+    METRICS_COUNTER,   // Only goes up: events, bytes, errors
+    METRICS_GAUGE,     // Current level: queue depth, setting
+    METRICS_HISTOGRAM, // Distribution of observed values
+};
+
+// One metric. `value` is the counter total, gauge level or histogram
+// count; `sum` and `buckets` are used by histograms only. Aligned so
+// metrics updated from different threads do not share cache lines.
+typedef struct {
+    char name[METRICS_NAME_LENGTH];
+    uint32_t type; // enum Metrics_type
+    uint32_t reserved;
+    atomic_llong value;
+    atomic_llong sum;
+    atomic_llong buckets[METRICS_HISTOGRAM_BUCKETS];
+} __attribute__((aligned(64))) Metrics_metric_t;
+
+// The shared-memory segment. Entries [0, num_entries) are complete:
+// registration fills in an entry before releasing the new count.
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t metric_size; // sizeof(Metrics_metric_t)
+    uint32_t max_entries;
+    atomic_uint num_entries;
+    int32_t pid;
+    uint32_t reserved;
+    int64_t start_time_ns; // CLOCK_REALTIME when the segment was created
+    Metrics_metric_t metrics[METRICS_MAX_ENTRIES];
+} __attribute__((aligned(64))) Metrics_segment_t;
+
+// init() creates (or replaces) the shared segment and must be called
+// before any register function; cleanup() removes the segment.
+// If shared memory is unavailable, metrics still work but are private.
+void Metrics_init(void);
+void Metrics_cleanup(void);
+
+// Register a metric and return it for updates. Names are up to
+// METRICS_NAME_LENGTH - 1 characters, e.g. "mixer.short_writes".
+// If the registry is full, returns a scratch metric that is not exported.
+Metrics_metric_t *Metrics_registerCounter(const char *name);
+Metrics_metric_t *Metrics_registerGauge(const char *name);
+Metrics_metric_t *Metrics_registerHistogram(const char *name);
+
+// Add to a counter.
+static inline void Metrics_add(Metrics_metric_t *pMetric, long long amount)
+{
+    atomic_fetch_add_explicit(&pMetric->value, amount, memory_order_relaxed);
+}
+
+// Set a gauge.
+static inline void Metrics_set(Metrics_metric_t *pMetric, long long value)
+{
+    atomic_store_explicit(&pMetric->value, value, memory_order_relaxed);
+}
+
+// Index of the histogram bucket holding `value`.
+static inline int Metrics_bucketOf(long long value)
+{
+    if (value <= 0)
+    {
+        return 0;
+    }
+    int bucket = 64 - __builtin_clzll((unsigned long long)value);
+    return (bucket < METRICS_HISTOGRAM_BUCKETS) ? bucket : METRICS_HISTOGRAM_BUCKETS - 1;
+}
+
+// Record one value in a histogram. Readers may see the count, sum and
+// bucket of a concurrent observation at slightly different times.
+static inline void Metrics_observe(Metrics_metric_t *pMetric, long long value)
+{
+    atomic_fetch_add_explicit(&pMetric->buckets[Metrics_bucketOf(value)], 1,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&pMetric->sum, value, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pMetric->value, 1, memory_order_relaxed);
+}
+
+#endif
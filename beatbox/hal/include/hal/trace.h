@@ -0,0 +1,94 @@
+// Module that records what every thread is doing, for viewing as a
+// timeline in Perfetto (ui.perfetto.dev) or chrome://tracing.
+//
+// Each thread records into its own lock-free ring of the most recent
+// TRACE_EVENTS_PER_THREAD events:
+// - spans: Trace_beginSpan() ... Trace_endSpan("name", start)
+// - instants: Trace_instant("name")
+// - counters: Trace_counter("name", value)
+// Event names must be string literals (only the pointer is stored).
+// Timestamps come from the CycleClock, so recording costs a counter read
+// and a few stores. While tracing is disabled each call is one relaxed
+// load and a branch.
+//
+// The rings are written out as Chrome trace-event JSON by Trace_dump(),
+// on SIGUSR1, or through Trace_requestDump() (e.g. from a UDP command).
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal/cycleClock.h"
+
+#define TRACE_EVENTS_PER_THREAD 4096 // Power of two
+
+// Start the module (and its dump thread); `dump_path` is where
+// SIGUSR1 and Trace_requestDump() write the trace. Tracing starts
+// enabled if `enabled`.
+void Trace_init(const char *dump_path, bool enabled);
+void Trace_cleanup(void);
+
+// Turn recording on/off at run time; already recorded events are kept.
+void Trace_setEnabled(bool enabled);
+
+// Name the calling thread in the trace (up to 15 characters). Costs no
+// memory until the thread records an event while tracing is on.
+void Trace_setThreadName(const char *name);
+
+// Write every thread's recorded events to `path` as Chrome trace JSON.
+// Returns false if the file could not be written.
+bool Trace_dump(const char *path);
+
+// Ask the dump thread to write the trace to the init() path.
+// Safe to call from a signal handler.
+void Trace_requestDump(void);
+
+// Implementation details used by the inline functions below
+enum Trace_eventType {
+    TRACE_EVENT_SPAN,
+    TRACE_EVENT_INSTANT,
+    TRACE_EVENT_COUNTER,
+};
+extern atomic_bool Trace_enabled;
+void Trace_record(enum Trace_eventType type, const char *name,
+                  uint64_t timestamp, uint64_t value);
+
+// Start a span: pass the result to Trace_endSpan(). 0 when disabled.
+static inline uint64_t Trace_beginSpan(void)
+{
+    if (!atomic_load_explicit(&Trace_enabled, memory_order_relaxed))
+    {
+        return 0;
+    }
+    return CycleClock_now();
+}
+
+// Record a span from `start` (from Trace_beginSpan()) until now.
+static inline void Trace_endSpan(const char *name, uint64_t start)
+{
+    if (start != 0)
+    {
+        Trace_record(TRACE_EVENT_SPAN, name, start, CycleClock_now() - start);
+    }
+}
+
+// Record a point in time.
+static inline void Trace_instant(const char *name)
+{
+    if (atomic_load_explicit(&Trace_enabled, memory_order_relaxed))
+    {
+        Trace_record(TRACE_EVENT_INSTANT, name, CycleClock_now(), 0);
+    }
+}
+
+// Record the value of a counter, e.g. a queue length.
+static inline void Trace_counter(const char *name, int64_t value)
+{
+    if (atomic_load_explicit(&Trace_enabled, memory_order_relaxed))
+    {
+        Trace_record(TRACE_EVENT_COUNTER, name, CycleClock_now(), (uint64_t)value);
+    }
+}
+
+#endif
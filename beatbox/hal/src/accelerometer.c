@@ -1,18 +1,16 @@
 // This file is used to read the accelerometer data 
-// from the I2C bus and return the data 
+// from the I2C bus (one burst read per sample) and return the data 
 #include <stdio.h>
 #include <stdlib.h>
-#include <fcntl.h>
 #include <unistd.h>
-#include <sys/ioctl.h>
-#include <linux/i2c.h>
-#include <linux/i2c-dev.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <pthread.h>
 #include <time.h>
 
 #include "hal/accelerometer.h"
+#include "hal/i2c.h"
+#include "hal/trace.h"
 
 // Device bus & address
 #define I2CDRV_LINUX_BUS "/dev/i2c-1"
@@ -27,88 +25,45 @@
 #define ACCEL_OUT_Z_L 0x2C
 #define ACCEL_OUT_Z_H 0x2D
 
+// Set on a register address to read several registers in one burst
+#define ACCEL_AUTO_INCREMENT 0x80
+#define ACCEL_NUM_OUT_BYTES 6
+
 // Thread control
 static pthread_t accel_thread;
 static volatile bool keep_running = false;
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static int i2c_file_desc = -1;
+static I2c_bus_t *pBus = NULL;
 static bool is_initialized = false;
 
 static int16_t current_x = 0;
 static int16_t current_y = 0;
 static int16_t current_z = 0;
 
-static int init_i2c_bus(char* bus, int address);
-static bool write_register(uint8_t reg, uint8_t value);
-static uint8_t read_register(uint8_t reg);
 static void* accelerometer_thread_function(void* arg);
 
-// Initialize I2C bus
-static int init_i2c_bus(char* bus, int address)
-{
-    int file_desc = open(bus, O_RDWR);
-    if (file_desc == -1) {
-        printf("I2C DRV: Unable to open bus for read/write (%s)\n", bus);
-        perror("Error is:");
-        return -1;
-    }
-    
-    if (ioctl(file_desc, I2C_SLAVE, address) == -1) {
-        printf("I2C DRV: Unable to set I2C device to slave address.\n");
-        perror("Error is:");
-        return -1;
-    }
-    
-    return file_desc;
-}
-
-// Write a single byte to a register
-static bool write_register(uint8_t reg, uint8_t value)
-{
-    uint8_t buf[2] = {reg, value};
-    if (write(i2c_file_desc, buf, 2) != 2) {
-        printf("I2C DRV: Failed to write to register 0x%02X\n", reg);
-        return false;
-    }
-    return true;
-}
-
-// Read a single byte from a register
-static uint8_t read_register(uint8_t reg)
-{
-    uint8_t value;
-    if (write(i2c_file_desc, &reg, 1) != 1) {
-        printf("I2C DRV: Failed to write register address\n");
-        return 0;
-    }
-    if (read(i2c_file_desc, &value, 1) != 1) {
-        printf("I2C DRV: Failed to read from register 0x%02X\n", reg);
-        return 0;
-    }
-    return value;
-}
-
 // Thread function to read the accelerometer data
 static void* accelerometer_thread_function(void* arg)
 {
     (void)arg; 
+    Trace_setThreadName("accelerometer");
 
     while (keep_running) {
         
-        int16_t x, y, z;
-        
-        uint8_t x_l = read_register(ACCEL_OUT_X_L);
-        uint8_t x_h = read_register(ACCEL_OUT_X_H);
-        x = (int16_t)((x_h << 8) | x_l);
-
-        uint8_t y_l = read_register(ACCEL_OUT_Y_L);
-        uint8_t y_h = read_register(ACCEL_OUT_Y_H);
-        y = (int16_t)((y_h << 8) | y_l);
-
-        uint8_t z_l = read_register(ACCEL_OUT_Z_L);
-        uint8_t z_h = read_register(ACCEL_OUT_Z_H);
-        z = (int16_t)((z_h << 8) | z_l);
+        // All six output registers in one transaction, so the axes
+        // come from the same conversion
+        uint8_t out[ACCEL_NUM_OUT_BYTES];
+        if (!I2c_readRegs(pBus, ACCEL_ADDR, ACCEL_OUT_X_L | ACCEL_AUTO_INCREMENT,
+                          out, sizeof(out))) {
+            printf("I2C DRV: Failed to read accelerometer output registers\n");
+            usleep(10000);
+            continue;
+        }
+
+        int16_t x = (int16_t)((out[1] << 8) | out[0]);
+        int16_t y = (int16_t)((out[3] << 8) | out[2]);
+        int16_t z = (int16_t)((out[5] << 8) | out[4]);
 
         pthread_mutex_lock(&mutex);
         current_x = x;
@@ -129,12 +84,15 @@ bool Accelerometer_init(void)
         return true;
     }
 
-    i2c_file_desc = init_i2c_bus(I2CDRV_LINUX_BUS, ACCEL_ADDR);
-    if (i2c_file_desc == -1) {
+    pBus = I2c_openBus(I2CDRV_LINUX_BUS);
+    if (pBus == NULL) {
         return false;
     }
 
-    if (!write_register(ACCEL_CTRL_REG1, 0x47)) { 
+    if (!I2c_writeReg8(pBus, ACCEL_ADDR, ACCEL_CTRL_REG1, 0x47)) {
+        printf("I2C DRV: Failed to write to register 0x%02X\n", ACCEL_CTRL_REG1);
+        I2c_closeBus(pBus);
+        pBus = NULL;
         return false;
     }
 
@@ -159,9 +117,9 @@ void Accelerometer_cleanup(void)
     keep_running = false;
     pthread_join(accel_thread, NULL);
 
-    if (i2c_file_desc != -1) {
-        close(i2c_file_desc);
-        i2c_file_desc = -1;
+    if (pBus != NULL) {
+        I2c_closeBus(pBus);
+        pBus = NULL;
     }
 
     is_initialized = false;
@@ -170,7 +128,7 @@ void Accelerometer_cleanup(void)
 // Read the raw accelerometer data
 bool Accelerometer_readRaw(int16_t* x, int16_t* y, int16_t* z)
 {
-    if (!is_initialized || i2c_file_desc == -1) {
+    if (!is_initialized || pBus == NULL) {
         return false;
     }
 
@@ -2,6 +2,8 @@
 // to be mixed together and played without jitter.
 // Note: Generates low latency audio on BeagleBone Black; higher latency found on host.
 #include "hal/audioMixer.h"
+#include "hal/metrics.h"
+#include "hal/trace.h"
 #include <alsa/asoundlib.h>
 #include <stdbool.h>
 #include <pthread.h>
@@ -51,8 +53,26 @@ static pthread_mutex_t audioMutex = PTHREAD_MUTEX_INITIALIZER;
 
 static int volume = 0;
 
+// Health metrics, exported through the metrics registry
+static Metrics_metric_t *pSoundsQueued;
+static Metrics_metric_t *pSlotsExhausted;
+static Metrics_metric_t *pActiveSounds;
+static Metrics_metric_t *pVolumeLevel;
+static Metrics_metric_t *pFillTimeUs;
+static Metrics_metric_t *pUnderruns;
+static Metrics_metric_t *pShortWrites;
+
 void AudioMixer_init(void)
 {
+    pSoundsQueued = Metrics_registerCounter("mixer.sounds_queued");
+    pSlotsExhausted = Metrics_registerCounter("mixer.slots_exhausted");
+    pActiveSounds = Metrics_registerGauge("mixer.active_sounds");
+    pVolumeLevel = Metrics_registerGauge("mixer.volume");
+    pFillTimeUs = Metrics_registerHistogram("mixer.fill_time_us");
+    pUnderruns = Metrics_registerCounter("mixer.underruns");
+    pShortWrites = Metrics_registerCounter("mixer.short_writes");
+    CycleClock_init();
+
     AudioMixer_setVolume(DEFAULT_VOLUME);
 
     // Initialize the currently active sound-bites being played
@@ -175,12 +195,13 @@ void AudioMixer_queueSound(wavedata_t *pSound)
     // Unlock the mutex
     pthread_mutex_unlock(&audioMutex);
 
-    // If we didn't find an empty slot, print an error
+    // If we didn't find an empty slot, the sound is dropped
     if (i == MAX_SOUND_BITES)
     {
-        fprintf(stderr, "ERROR: No free slots available to queue sound.\n");
+        Metrics_add(pSlotsExhausted, 1);
         return;
     }
+    Metrics_add(pSoundsQueued, 1);
 }
 
 void AudioMixer_cleanup(void)
@@ -212,6 +233,11 @@ int AudioMixer_getVolume()
     return volume;
 }
 
+double AudioMixer_getBufferPeriodMs(void)
+{
+    return playbackBufferSize * 1000.0 / SAMPLE_RATE;
+}
+
 // Function copied from:
 // http://stackoverflow.com/questions/6787318/set-alsa-master-volume-from-c-code
 // Written by user "trenki".
@@ -224,6 +250,7 @@ void AudioMixer_setVolume(int newVolume)
         return;
     }
     volume = newVolume;
+    Metrics_set(pVolumeLevel, volume);
 
     long min, max;
     snd_mixer_t *mixerHandle;
@@ -261,11 +288,14 @@ static void fillPlaybackBuffer(short *buff, int size)
     pthread_mutex_lock(&audioMutex);
 
     // Loop through each slot in soundBites[]
+    int activeSounds = 0;
     for (int i = 0; i < MAX_SOUND_BITES; i++)
     {
         // Check if this sound bite slot is used
         if (soundBites[i].pSound != NULL)
         {
+            activeSounds++;
+
             // Grab the sound and current location for efficiency
             wavedata_t *sound = soundBites[i].pSound;
             int location = soundBites[i].location;
@@ -312,29 +342,37 @@ static void fillPlaybackBuffer(short *buff, int size)
 
     // Unlock the mutex
     pthread_mutex_unlock(&audioMutex);
+    Metrics_set(pActiveSounds, activeSounds);
 }
 
 void *playbackThread(void *arg)
 {
     // Suppress unused parameter warning
     (void)arg;
+    Trace_setThreadName("audio playback");
 
     while (!stopping)
     {
         // Generate next block of audio
+        uint64_t span = Trace_beginSpan();
+        uint64_t fillStart = CycleClock_now();
         fillPlaybackBuffer(playbackBuffer, playbackBufferSize);
+        Metrics_observe(pFillTimeUs, CycleClock_ticksToNs(CycleClock_now() - fillStart) / 1000);
+        Trace_endSpan("fillPlaybackBuffer", span);
 
         // Mark audio event for timing statistics
         TerminalDisplay_markAudioEvent();
 
         // Output the audio
+        span = Trace_beginSpan();
         snd_pcm_sframes_t frames = snd_pcm_writei(handle,
                                                   playbackBuffer, playbackBufferSize);
+        Trace_endSpan("snd_pcm_writei", span);
 
         // Check for (and handle) possible error conditions on output
         if (frames < 0)
         {
-            fprintf(stderr, "AudioMixer: writei() returned %li\n", frames);
+            Metrics_add(pUnderruns, 1);
             frames = snd_pcm_recover(handle, frames, 1);
         }
         if (frames < 0)
@@ -345,8 +383,7 @@ void *playbackThread(void *arg)
         }
         if (frames > 0 && frames < (snd_pcm_sframes_t)playbackBufferSize)
         {
-            printf("Short write (expected %lu, wrote %li)\n",
-                   playbackBufferSize, frames);
+            Metrics_add(pShortWrites, 1);
         }
     }
 
@@ -0,0 +1,90 @@
+// Calibration of the CPU counter read by CycleClock_now().
+// aarch64 publishes the counter's frequency in CNTFRQ_EL0; the TSC's rate
+// is measured against CLOCK_MONOTONIC over a short busy wait. Either way a
+// matching (ticks, CLOCK_MONOTONIC) pair is recorded to convert readings
+// to absolute time.
+
+#define _POSIX_C_SOURCE 200809L
+#include "hal/cycleClock.h"
+#include <pthread.h>
+
+#define NS_PER_SECOND 1000000000LL
+#define CALIBRATION_NS (10 * 1000 * 1000)
+
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+static double ns_per_tick = 1.0;
+static uint64_t base_ticks = 0;
+static long long base_ns = 0;
+
+static long long monotonic_ns(void);
+static void sample_pair(uint64_t *pTicks, long long *pNs);
+static void calibrate(void);
+
+void CycleClock_init(void)
+{
+    pthread_once(&init_once, calibrate);
+}
+
+double CycleClock_nsPerTick(void)
+{
+    return ns_per_tick;
+}
+
+double CycleClock_ticksToNs(uint64_t ticks)
+{
+    return ticks * ns_per_tick;
+}
+
+long long CycleClock_toMonotonicNs(uint64_t ticks)
+{
+    // Signed, so readings taken just before calibration still convert
+    return base_ns + (long long)((double)(int64_t)(ticks - base_ticks) * ns_per_tick);
+}
+
+static long long monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+}
+
+// A counter reading and the CLOCK_MONOTONIC time it was taken at: the
+// middle of the tightest of a few bracketing reads
+static void sample_pair(uint64_t *pTicks, long long *pNs)
+{
+    long long best_window = -1;
+    for (int i = 0; i < 5; i++)
+    {
+        uint64_t before = CycleClock_now();
+        long long ns = monotonic_ns();
+        uint64_t after = CycleClock_now();
+        long long window = (long long)(after - before);
+        if (best_window < 0 || window < best_window)
+        {
+            best_window = window;
+            *pTicks = before + (after - before) / 2;
+            *pNs = ns;
+        }
+    }
+}
+
+static void calibrate(void)
+{
+    sample_pair(&base_ticks, &base_ns);
+
+#if defined(__aarch64__)
+    uint64_t frequency;
+    __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+    ns_per_tick = (double)NS_PER_SECOND / frequency;
+#elif defined(__x86_64__) || defined(__i386__)
+    uint64_t end_ticks;
+    long long end_ns;
+    do
+    {
+        sample_pair(&end_ticks, &end_ns);
+    } while (end_ns - base_ns < CALIBRATION_NS);
+    ns_per_tick = (double)(end_ns - base_ns) / (end_ticks - base_ticks);
+#else
+    ns_per_tick = 1.0; // Ticks are CLOCK_MONOTONIC ns
+#endif
+}
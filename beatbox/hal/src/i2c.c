@@ -0,0 +1,200 @@
+// Shared I2C buses with combined-transaction register access.
+
+#include "hal/i2c.h"
+#include "hal/metrics.h"
+#include "hal/trace.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#define MAX_BUSES 4
+#define MAX_PATH_LENGTH 32
+#define MAX_METRIC_DEVICE_LENGTH 16 // Of the device name in metric names, e.g. "i2c-1"
+
+struct I2c_bus {
+    char path[MAX_PATH_LENGTH];
+    int file_desc;
+    int num_opens;
+    // Counters, registered as metrics on the bus's first open
+    Metrics_metric_t *pTransactions; // System calls made (one bus transaction each)
+    Metrics_metric_t *pBytesWritten; // Including register addresses
+    Metrics_metric_t *pBytesRead;
+    Metrics_metric_t *pErrors;
+};
+
+// Buses are opened and closed under buses_lock; transfers need no lock,
+// since each is a single system call.
+static pthread_mutex_t buses_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct I2c_bus buses[MAX_BUSES];
+
+static void register_metrics(I2c_bus_t *pBus);
+
+I2c_bus_t *I2c_openBus(const char *path)
+{
+    assert(strlen(path) < MAX_PATH_LENGTH);
+
+    pthread_mutex_lock(&buses_lock);
+    I2c_bus_t *pFree = NULL;
+    for (int i = 0; i < MAX_BUSES; i++)
+    {
+        I2c_bus_t *pBus = &buses[i];
+        if (pBus->num_opens > 0 && strcmp(pBus->path, path) == 0)
+        {
+            pBus->num_opens++;
+            pthread_mutex_unlock(&buses_lock);
+            return pBus;
+        }
+        if (pBus->num_opens == 0 && !pFree)
+        {
+            pFree = pBus;
+        }
+    }
+
+    if (!pFree)
+    {
+        printf("I2C DRV: Too many buses open\n");
+        pthread_mutex_unlock(&buses_lock);
+        return NULL;
+    }
+
+    int file_desc = open(path, O_RDWR);
+    if (file_desc == -1)
+    {
+        printf("I2C DRV: Unable to open bus for read/write (%s)\n", path);
+        perror("Error is:");
+        pthread_mutex_unlock(&buses_lock);
+        return NULL;
+    }
+
+    // A slot reopened on the same bus keeps its metrics, restarted at zero
+    if (!pFree->pTransactions || strcmp(pFree->path, path) != 0)
+    {
+        strcpy(pFree->path, path);
+        register_metrics(pFree);
+    }
+    Metrics_set(pFree->pTransactions, 0);
+    Metrics_set(pFree->pBytesWritten, 0);
+    Metrics_set(pFree->pBytesRead, 0);
+    Metrics_set(pFree->pErrors, 0);
+    pFree->file_desc = file_desc;
+    pFree->num_opens = 1;
+    pthread_mutex_unlock(&buses_lock);
+    return pFree;
+}
+
+void I2c_closeBus(I2c_bus_t *pBus)
+{
+    pthread_mutex_lock(&buses_lock);
+    assert(pBus->num_opens > 0);
+    if (--pBus->num_opens == 0)
+    {
+        close(pBus->file_desc);
+        pBus->file_desc = -1;
+    }
+    pthread_mutex_unlock(&buses_lock);
+}
+
+// Issue the messages as one transaction and count it
+static bool transfer(I2c_bus_t *pBus, struct i2c_msg *pMessages, int num_messages)
+{
+    struct i2c_rdwr_ioctl_data transaction = {
+        .msgs = pMessages,
+        .nmsgs = num_messages,
+    };
+
+    Metrics_add(pBus->pTransactions, 1);
+    uint64_t span = Trace_beginSpan();
+    int result = ioctl(pBus->file_desc, I2C_RDWR, &transaction);
+    Trace_endSpan((pMessages[num_messages - 1].flags & I2C_M_RD) ? "I2C read" : "I2C write",
+                  span);
+    if (result != num_messages)
+    {
+        Metrics_add(pBus->pErrors, 1);
+        return false;
+    }
+
+    for (int i = 0; i < num_messages; i++)
+    {
+        Metrics_add((pMessages[i].flags & I2C_M_RD) ? pBus->pBytesRead : pBus->pBytesWritten,
+                    pMessages[i].len);
+    }
+    return true;
+}
+
+bool I2c_writeReg8(I2c_bus_t *pBus, uint8_t address, uint8_t reg, uint8_t value)
+{
+    uint8_t buff[2] = {reg, value};
+    struct i2c_msg message = {
+        .addr = address,
+        .flags = 0,
+        .len = sizeof(buff),
+        .buf = buff,
+    };
+    return transfer(pBus, &message, 1);
+}
+
+bool I2c_writeReg16(I2c_bus_t *pBus, uint8_t address, uint8_t reg, uint16_t value)
+{
+    uint8_t buff[3] = {reg, value & 0xFF, (value & 0xFF00) >> 8};
+    struct i2c_msg message = {
+        .addr = address,
+        .flags = 0,
+        .len = sizeof(buff),
+        .buf = buff,
+    };
+    return transfer(pBus, &message, 1);
+}
+
+bool I2c_readRegs(I2c_bus_t *pBus, uint8_t address, uint8_t reg,
+                  uint8_t *pData, size_t length)
+{
+    // Register address write, then a repeated start into the read
+    struct i2c_msg messages[2] = {
+        {.addr = address, .flags = 0, .len = 1, .buf = &reg},
+        {.addr = address, .flags = I2C_M_RD, .len = length, .buf = pData},
+    };
+    return transfer(pBus, messages, 2);
+}
+
+bool I2c_readReg16(I2c_bus_t *pBus, uint8_t address, uint8_t reg, uint16_t *pValue)
+{
+    uint8_t buff[2];
+    if (!I2c_readRegs(pBus, address, reg, buff, sizeof(buff)))
+    {
+        return false;
+    }
+    memcpy(pValue, buff, sizeof(buff));
+    return true;
+}
+
+void I2c_getStats(I2c_bus_t *pBus, I2c_stats_t *pStats)
+{
+    pStats->transactions = atomic_load_explicit(&pBus->pTransactions->value, memory_order_relaxed);
+    pStats->bytes_written = atomic_load_explicit(&pBus->pBytesWritten->value, memory_order_relaxed);
+    pStats->bytes_read = atomic_load_explicit(&pBus->pBytesRead->value, memory_order_relaxed);
+    pStats->errors = atomic_load_explicit(&pBus->pErrors->value, memory_order_relaxed);
+}
+
+// Register the bus's counters as "i2c.<device>.<counter>", e.g.
+// "i2c.i2c-1.transactions" for /dev/i2c-1
+static void register_metrics(I2c_bus_t *pBus)
+{
+    const char *device = strrchr(pBus->path, '/');
+    device = device ? device + 1 : pBus->path;
+
+    char name[METRICS_NAME_LENGTH];
+    snprintf(name, sizeof(name), "i2c.%.*s.transactions", MAX_METRIC_DEVICE_LENGTH, device);
+    pBus->pTransactions = Metrics_registerCounter(name);
+    snprintf(name, sizeof(name), "i2c.%.*s.bytes_written", MAX_METRIC_DEVICE_LENGTH, device);
+    pBus->pBytesWritten = Metrics_registerCounter(name);
+    snprintf(name, sizeof(name), "i2c.%.*s.bytes_read", MAX_METRIC_DEVICE_LENGTH, device);
+    pBus->pBytesRead = Metrics_registerCounter(name);
+    snprintf(name, sizeof(name), "i2c.%.*s.errors", MAX_METRIC_DEVICE_LENGTH, device);
+    pBus->pErrors = Metrics_registerCounter(name);
+}
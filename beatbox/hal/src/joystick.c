@@ -1,13 +1,11 @@
 // This file is used to read the joystick data 
-// from the I2C bus and return the data as a struct
+// from the shared TLA2024 ADC and return the data as a struct
 #include "hal/joystick.h"
+#include "hal/tla2024.h"
+#include "hal/trace.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <fcntl.h>
 #include <unistd.h>
-#include <sys/ioctl.h>
-#include <linux/i2c.h>
-#include <linux/i2c-dev.h>
 #include <time.h>
 #include <pthread.h>
 #include <string.h>
@@ -15,14 +13,9 @@
 #include "hal/gpio.h" // Add GPIO header
 #include <gpiod.h>
 
-// I2C configuration for Zen HAT joystick
-#define I2CDRV_LINUX_BUS "/dev/i2c-1"
-#define I2C_DEVICE_ADDRESS 0x48
-#define REG_CONFIGURATION 0x01
-#define REG_DATA 0x00
-
-// Channel 0 for X-axis (up/down)
-#define JOYSTICK_X_CHANNEL 0x83C2 
+// ADC channel 0 for X-axis (up/down), scanned at the polling rate
+#define JOYSTICK_X_CHANNEL 0
+#define JOYSTICK_SCANS_PER_SECOND 100
 
 // GPIO configuration for joystick button
 #define JOYSTICK_BUTTON_CHIP GPIO_CHIP_2
@@ -43,94 +36,33 @@ static pthread_mutex_t joystickMutex = PTHREAD_MUTEX_INITIALIZER;
 static JoystickDirection currentDirection = JOYSTICK_NONE;
 static bool buttonPressed = false;
 
-// I2C and GPIO handles
-static int i2c_file_desc = -1;
+// ADC and GPIO handles
+static bool adc_open = false;
 static struct GpioLine *button_gpio = NULL;
 
 // Private function prototypes
-static int init_i2c_bus(char *bus, int address);
-static void write_i2c_reg16(int i2c_file_desc, uint8_t reg_addr, uint16_t value);
-static uint16_t read_i2c_reg16(int i2c_file_desc, uint8_t reg_addr);
 static void *joystickSamplingThread(void *arg);
 static void *buttonSamplingThread(void *arg);
 
-// Initialize I2C bus for joystick
-static int init_i2c_bus(char *bus, int address)
-{
-    int i2c_file_desc = open(bus, O_RDWR);
-    if (i2c_file_desc == -1)
-    {
-        printf("I2C: Unable to open bus for read/write (%s)\n", bus);
-        perror("Error is:");
-        return -1;
-    }
-    if (ioctl(i2c_file_desc, I2C_SLAVE, address) == -1)
-    {
-        perror("I2C: Unable to set device to slave address");
-        close(i2c_file_desc);
-        return -1;
-    }
-    return i2c_file_desc;
-}
-
-// Write to I2C register
-static void write_i2c_reg16(int i2c_file_desc, uint8_t reg_addr, uint16_t value)
-{
-    int tx_size = 1 + sizeof(value);
-    uint8_t buff[tx_size];
-    buff[0] = reg_addr;
-    buff[1] = (value & 0xFF);
-    buff[2] = (value & 0xFF00) >> 8;
-
-    if (write(i2c_file_desc, buff, tx_size) != tx_size)
-    {
-        perror("I2C write failure");
-    }
-}
-
-// Read from I2C register
-static uint16_t read_i2c_reg16(int i2c_file_desc, uint8_t reg_addr)
-{
-    if (write(i2c_file_desc, &reg_addr, 1) != 1)
-    {
-        perror("I2C register select failed");
-        return 0;
-    }
-    uint16_t value = 0;
-    int bytes_read = read(i2c_file_desc, &value, sizeof(value));
-    if (bytes_read != sizeof(value))
-    {
-        perror("I2C read failed");
-        return 0;
-    }
-    return value;
-}
-
 // Thread for continuously reading joystick position
 static void *joystickSamplingThread(void *arg)
 {
     (void)arg; 
-
-    if (i2c_file_desc >= 0)
-    {
-        write_i2c_reg16(i2c_file_desc, REG_CONFIGURATION, JOYSTICK_X_CHANNEL);
-    }
+    Trace_setThreadName("joystick");
 
     JoystickDirection lastRawDirection = JOYSTICK_NONE;
     int stableCount = 0;
 
     while (isJoystickRunning)
     {
-        if (i2c_file_desc < 0)
+        Tla2024_reading_t reading = Tla2024_read(JOYSTICK_X_CHANNEL);
+        if (!adc_open || reading.sequence == 0)
         {
             usleep(100000);
             continue;
         }
 
-        uint16_t raw_value = read_i2c_reg16(i2c_file_desc, REG_DATA);
-
-        uint16_t value = ((raw_value & 0xFF) << 8) | ((raw_value & 0xFF00) >> 8);
-        value >>= 4;
+        uint16_t value = reading.code;
 
         // Determine direction from value
         JoystickDirection rawDirection = JOYSTICK_NONE;
@@ -173,6 +105,7 @@ static void *joystickSamplingThread(void *arg)
 static void *buttonSamplingThread(void *arg)
 {
     (void)arg; 
+    Trace_setThreadName("joystick button");
 
     while (isButtonRunning && button_gpio != NULL)
     {
@@ -214,20 +147,11 @@ static void *buttonSamplingThread(void *arg)
 
 void Joystick_init(void)
 {
-    // Initialize I2C for the joystick
-    i2c_file_desc = init_i2c_bus(I2CDRV_LINUX_BUS, I2C_DEVICE_ADDRESS);
-    if (i2c_file_desc < 0)
-    {
-        printf("ERROR: Joystick I2C initialization failed\n");
-    }
-    else
+    // Have the shared ADC start scanning the joystick
+    adc_open = Tla2024_openChannel(JOYSTICK_X_CHANNEL, JOYSTICK_SCANS_PER_SECOND);
+    if (!adc_open)
     {
-        // Test I2C communication
-        write_i2c_reg16(i2c_file_desc, REG_CONFIGURATION, JOYSTICK_X_CHANNEL);
-        usleep(5000); // 5ms delay
-        uint16_t test_value = read_i2c_reg16(i2c_file_desc, REG_DATA);
-        uint16_t processed = ((test_value & 0xFF) << 8) | ((test_value & 0xFF00) >> 8);
-        processed >>= 4;
+        printf("ERROR: Joystick ADC initialization failed\n");
     }
 
     // Initialize GPIO for button
@@ -281,10 +205,10 @@ void Joystick_cleanup(void)
 {
     Joystick_stopSampling();
 
-    if (i2c_file_desc != -1)
+    if (adc_open)
     {
-        close(i2c_file_desc);
-        i2c_file_desc = -1;
+        Tla2024_closeChannel(JOYSTICK_X_CHANNEL);
+        adc_open = false;
     }
 
     if (button_gpio != NULL)
@@ -1,6 +1,7 @@
 // This file is used to display the LCD screen
 // and update the status, audio timing, and accelerometer timing
 #include "hal/lcdDisplay.h"
+#include "hal/trace.h"
 #include "DEV_Config.h"
 #include "LCD_1in54.h"
 #include "GUI_Paint.h"
@@ -27,14 +28,10 @@ static int currentVolume = 80;
 static int currentBpm = 120;
 
 // Audio timing data
-static double audioMinMs = 0.0;
-static double audioMaxMs = 0.0;
-static double audioAvgMs = 0.0;
+static LcdDisplay_timing_t audioTiming;
 
 // Accel timing data
-static double accelMinMs = 0.0;
-static double accelMaxMs = 0.0;
-static double accelAvgMs = 0.0;
+static LcdDisplay_timing_t accelTiming;
 
 // Initialize the LCD display
 void LcdDisplay_init(void)
@@ -140,14 +137,12 @@ void LcdDisplay_updateStatus(const char *name, int volume, int bpm)
 }
 
 // Update audio timing information
-void LcdDisplay_updateAudioTiming(double min, double max, double avg)
+void LcdDisplay_updateAudioTiming(const LcdDisplay_timing_t *pTiming)
 {
     if (!isInitialized)
         return;
 
-    audioMinMs = min;
-    audioMaxMs = max;
-    audioAvgMs = avg;
+    audioTiming = *pTiming;
 
     // Only refresh if we're on the audio timing screen
     if (currentScreen == LCD_SCREEN_AUDIO_TIMING)
@@ -157,14 +152,12 @@ void LcdDisplay_updateAudioTiming(double min, double max, double avg)
 }
 
 // Update accelerometer timing information
-void LcdDisplay_updateAccelTiming(double min, double max, double avg)
+void LcdDisplay_updateAccelTiming(const LcdDisplay_timing_t *pTiming)
 {
     if (!isInitialized)
         return;
 
-    accelMinMs = min;
-    accelMaxMs = max;
-    accelAvgMs = avg;
+    accelTiming = *pTiming;
 
     // Only refresh if we're on the accelerometer timing screen
     if (currentScreen == LCD_SCREEN_ACCEL_TIMING)
@@ -203,40 +196,41 @@ static void render_status_screen(void)
     Paint_DrawString_EN(bpm_x, LCD_1IN54_HEIGHT - 30, bpmStr, &Font16, BLACK, WHITE);
 }
 
-// Render the audio timing screen
-static void render_audio_timing_screen(void)
+// Render a timing screen: min/max/avg, then the percentiles that show
+// jitter the average hides
+static void render_timing_screen(const char *title, const LcdDisplay_timing_t *pTiming)
 {
     // Title at the top
-    Paint_DrawString_EN(5, 5, "Audio Timing", &Font20, BLACK, WHITE);
+    Paint_DrawString_EN(5, 5, title, &Font20, BLACK, WHITE);
 
     // Format timing data
-    char minStr[32], maxStr[32], avgStr[32];
-    snprintf(minStr, sizeof(minStr), "Min: %.3f ms", audioMinMs);
-    snprintf(maxStr, sizeof(maxStr), "Max: %.3f ms", audioMaxMs);
-    snprintf(avgStr, sizeof(avgStr), "Avg: %.3f ms", audioAvgMs);
+    char lines[8][32];
+    snprintf(lines[0], sizeof(lines[0]), "Min: %.3f ms", pTiming->minMs);
+    snprintf(lines[1], sizeof(lines[1]), "Max: %.3f ms", pTiming->maxMs);
+    snprintf(lines[2], sizeof(lines[2]), "Avg: %.3f ms", pTiming->avgMs);
+    snprintf(lines[3], sizeof(lines[3]), "p50: %.3f ms", pTiming->p50Ms);
+    snprintf(lines[4], sizeof(lines[4]), "p90: %.3f ms", pTiming->p90Ms);
+    snprintf(lines[5], sizeof(lines[5]), "p99: %.3f ms", pTiming->p99Ms);
+    snprintf(lines[6], sizeof(lines[6]), "p99.9: %.3f ms", pTiming->p999Ms);
+    snprintf(lines[7], sizeof(lines[7]), "Late: %d", pTiming->numLate);
 
     // Display timing data
-    Paint_DrawString_EN(10, 40, minStr, &Font16, BLACK, WHITE);
-    Paint_DrawString_EN(10, 70, maxStr, &Font16, BLACK, WHITE);
-    Paint_DrawString_EN(10, 100, avgStr, &Font16, BLACK, WHITE);
+    for (int i = 0; i < 8; i++)
+    {
+        Paint_DrawString_EN(10, 35 + i * 25, lines[i], &Font16, BLACK, WHITE);
+    }
+}
+
+// Render the audio timing screen
+static void render_audio_timing_screen(void)
+{
+    render_timing_screen("Audio Timing", &audioTiming);
 }
 
 // Render the accelerometer timing screen
 static void render_accel_timing_screen(void)
 {
-    // Title at the top
-    Paint_DrawString_EN(5, 5, "Accel. Timing", &Font20, BLACK, WHITE);
-
-    // Format timing data
-    char minStr[32], maxStr[32], avgStr[32];
-    snprintf(minStr, sizeof(minStr), "Min: %.3f ms", accelMinMs);
-    snprintf(maxStr, sizeof(maxStr), "Max: %.3f ms", accelMaxMs);
-    snprintf(avgStr, sizeof(avgStr), "Avg: %.3f ms", accelAvgMs);
-
-    // Display timing data
-    Paint_DrawString_EN(10, 40, minStr, &Font16, BLACK, WHITE);
-    Paint_DrawString_EN(10, 70, maxStr, &Font16, BLACK, WHITE);
-    Paint_DrawString_EN(10, 100, avgStr, &Font16, BLACK, WHITE);
+    render_timing_screen("Accel. Timing", &accelTiming);
 }
 
 // Force a screen refresh
@@ -244,6 +238,7 @@ void LcdDisplay_refresh(void)
 {
     if (!isInitialized || s_frameBuffer == NULL)
         return;
+    uint64_t refreshSpan = Trace_beginSpan();
 
     // Initialize the RAM frame buffer to be blank (white)
     Paint_NewImage(s_frameBuffer, LCD_1IN54_WIDTH, LCD_1IN54_HEIGHT, 0, WHITE, 16);
@@ -269,5 +264,8 @@ void LcdDisplay_refresh(void)
         break;
     }
 
+    uint64_t displaySpan = Trace_beginSpan();
     LCD_1IN54_Display(s_frameBuffer);
+    Trace_endSpan("LCD_1IN54_Display", displaySpan);
+    Trace_endSpan("LcdDisplay_refresh", refreshSpan);
 }
\ No newline at end of file
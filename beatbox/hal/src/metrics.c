@@ -0,0 +1,146 @@
+// Metrics registry in a POSIX shared-memory segment.
+// Registration is rare and takes a lock; updates are plain relaxed
+// atomics on the mapped entries, so readers in other processes see them
+// without any help from this process.
+
+#include "hal/metrics.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static Metrics_segment_t *pSegment = NULL;
+static bool is_shared = false;
+static pthread_mutex_t register_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Handed out once the registry is full, so callers never check for NULL
+static Metrics_metric_t scratch_metric;
+
+static Metrics_segment_t *map_shared_segment(void);
+static Metrics_metric_t *register_metric(const char *name, enum Metrics_type type);
+
+void Metrics_init(void)
+{
+    assert(pSegment == NULL);
+
+    pSegment = map_shared_segment();
+    is_shared = (pSegment != NULL);
+    if (!is_shared)
+    {
+        printf("Metrics: shared memory unavailable; metrics are not exported\n");
+        pSegment = aligned_alloc(_Alignof(Metrics_segment_t), sizeof(*pSegment));
+        if (!pSegment)
+        {
+            perror("Metrics: unable to allocate registry");
+            exit(EXIT_FAILURE);
+        }
+        memset(pSegment, 0, sizeof(*pSegment));
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    pSegment->version = METRICS_VERSION;
+    pSegment->metric_size = sizeof(Metrics_metric_t);
+    pSegment->max_entries = METRICS_MAX_ENTRIES;
+    pSegment->pid = getpid();
+    pSegment->start_time_ns = now.tv_sec * 1000000000LL + now.tv_nsec;
+    atomic_store(&pSegment->num_entries, 0);
+
+    // Written last: a reader that sees the magic sees a valid header
+    atomic_thread_fence(memory_order_release);
+    pSegment->magic = METRICS_MAGIC;
+}
+
+void Metrics_cleanup(void)
+{
+    assert(pSegment != NULL);
+
+    if (is_shared)
+    {
+        munmap(pSegment, sizeof(*pSegment));
+        shm_unlink(METRICS_SHM_NAME);
+    }
+    else
+    {
+        free(pSegment);
+    }
+    pSegment = NULL;
+}
+
+Metrics_metric_t *Metrics_registerCounter(const char *name)
+{
+    return register_metric(name, METRICS_COUNTER);
+}
+
+Metrics_metric_t *Metrics_registerGauge(const char *name)
+{
+    return register_metric(name, METRICS_GAUGE);
+}
+
+Metrics_metric_t *Metrics_registerHistogram(const char *name)
+{
+    return register_metric(name, METRICS_HISTOGRAM);
+}
+
+// Create a fresh segment, replacing any left by an earlier run.
+// Returns NULL on failure.
+static Metrics_segment_t *map_shared_segment(void)
+{
+    shm_unlink(METRICS_SHM_NAME);
+    int fd = shm_open(METRICS_SHM_NAME, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        perror("Metrics: shm_open");
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(Metrics_segment_t)) != 0)
+    {
+        perror("Metrics: ftruncate");
+        close(fd);
+        shm_unlink(METRICS_SHM_NAME);
+        return NULL;
+    }
+
+    // New shared memory is zero-filled
+    void *pMemory = mmap(NULL, sizeof(Metrics_segment_t), PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    close(fd);
+    if (pMemory == MAP_FAILED)
+    {
+        perror("Metrics: mmap");
+        shm_unlink(METRICS_SHM_NAME);
+        return NULL;
+    }
+    return pMemory;
+}
+
+static Metrics_metric_t *register_metric(const char *name, enum Metrics_type type)
+{
+    assert(pSegment != NULL);
+    assert(strlen(name) < METRICS_NAME_LENGTH);
+
+    pthread_mutex_lock(&register_lock);
+    unsigned int index = atomic_load_explicit(&pSegment->num_entries, memory_order_relaxed);
+    if (index == METRICS_MAX_ENTRIES)
+    {
+        pthread_mutex_unlock(&register_lock);
+        printf("Metrics: registry full; '%s' is not exported\n", name);
+        return &scratch_metric;
+    }
+
+    Metrics_metric_t *pMetric = &pSegment->metrics[index];
+    memset(pMetric, 0, sizeof(*pMetric));
+    snprintf(pMetric->name, sizeof(pMetric->name), "%s", name);
+    pMetric->type = type;
+
+    // Publish the completed entry to readers
+    atomic_store_explicit(&pSegment->num_entries, index + 1, memory_order_release);
+    pthread_mutex_unlock(&register_lock);
+    return pMetric;
+}
@@ -3,6 +3,7 @@
 #include "hal/rotaryEncoder.h"
 #include "hal/buttonStateMachine.h"
 #include "hal/gpio.h"
+#include "hal/trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -53,6 +54,7 @@ static long getCurrentTimeMs()
 static void *encoder_rotation_thread_function(void *arg)
 {
     (void)arg; 
+    Trace_setThreadName("encoder");
 
     // Create the event monitoring structures
     struct gpiod_line_bulk encoderBulk;
@@ -167,6 +169,7 @@ static void *encoder_rotation_thread_function(void *arg)
 static void *button_thread_function(void *arg)
 {
     (void)arg; 
+    Trace_setThreadName("encoder button");
 
     while (keep_running)
     {
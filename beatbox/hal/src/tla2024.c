@@ -0,0 +1,247 @@
+// Shared TLA2024 ADC: one scan thread owns the device and publishes
+// conversions into per-channel slots.
+
+#define _POSIX_C_SOURCE 200809L
+#include "hal/tla2024.h"
+#include "hal/i2c.h"
+#include "hal/trace.h"
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+// Device bus & address
+#define I2CDRV_LINUX_BUS "/dev/i2c-1"
+#define I2C_DEVICE_ADDRESS 0x48
+
+// Register in TLA2024
+#define REG_CONFIGURATION 0x01
+#define REG_DATA 0x00
+
+// Configuration (sent LSB first): continuous conversion at 3300 samples/s,
+// single-ended input selected by bits 6:4 of the low byte (0xC2 = AIN0).
+#define TLA2024_CONF_BASE 0xC3C2
+#define TLA2024_CONF_CHANNEL_SHIFT 4
+
+// After a mux change the conversion in progress restarts; wait a little
+// over one 3300 samples/s conversion time before reading.
+#define MUX_SETTLE_NS 350000
+
+#define NS_PER_SECOND 1000000000LL
+#define MAX_SCANS_PER_SECOND 3300
+#define NO_CHANNEL (-1)
+
+// Slot layout: (sequence << 16) | code, updated with a single store
+#define SLOT_SEQUENCE_SHIFT 16
+#define SLOT_CODE_MASK 0xFFFF
+
+// Which channels are open, at what rate; changed under open_lock
+static pthread_mutex_t open_lock = PTHREAD_MUTEX_INITIALIZER;
+static int channel_rates[TLA2024_NUM_CHANNELS];
+static int num_open = 0;
+static atomic_uint open_mask = 0;
+static atomic_llong scan_period_ns = 0;
+
+// Published conversions
+static atomic_ullong slots[TLA2024_NUM_CHANNELS];
+
+// Scan thread and the device it owns
+static pthread_t scan_thread;
+static atomic_bool should_stop = false;
+static I2c_bus_t *pBus = NULL;
+static int selected_channel = NO_CHANNEL;
+static bool reported_error = false;
+
+// Report the first failed transfer only; the scan keeps going and the
+// slot just keeps its last good value.
+static void report_error(const char *what)
+{
+    if (!reported_error)
+    {
+        printf("%s\n", what);
+        reported_error = true;
+    }
+}
+
+static void sleep_ns(long long ns)
+{
+    struct timespec delay = {ns / NS_PER_SECOND, ns % NS_PER_SECOND};
+    while (clock_nanosleep(CLOCK_MONOTONIC, 0, &delay, &delay) == EINTR)
+    {
+    }
+}
+
+static void scan_channel(int channel, bool switch_mux)
+{
+    if (switch_mux || selected_channel != channel)
+    {
+        uint16_t conf = TLA2024_CONF_BASE | (channel << TLA2024_CONF_CHANNEL_SHIFT);
+        if (!I2c_writeReg16(pBus, I2C_DEVICE_ADDRESS, REG_CONFIGURATION, conf))
+        {
+            report_error("TLA2024: unable to select channel");
+            selected_channel = NO_CHANNEL;
+            return;
+        }
+        selected_channel = channel;
+        sleep_ns(MUX_SETTLE_NS);
+    }
+
+    uint16_t raw_read = 0;
+    if (!I2c_readReg16(pBus, I2C_DEVICE_ADDRESS, REG_DATA, &raw_read))
+    {
+        report_error("TLA2024: unable to read conversion");
+        return;
+    }
+
+    // Convert from LSB first to MSB first, then right align the 12-bit value
+    uint16_t code = (((raw_read & 0xFF) << 8) | ((raw_read & 0xFF00) >> 8)) >> 4;
+
+    // Only this thread writes the slot, so a load + store is enough
+    uint64_t slot = atomic_load_explicit(&slots[channel], memory_order_relaxed);
+    uint64_t sequence = (slot >> SLOT_SEQUENCE_SHIFT) + 1;
+    atomic_store_explicit(&slots[channel], (sequence << SLOT_SEQUENCE_SHIFT) | code,
+                          memory_order_release);
+}
+
+static void timespec_add_ns(struct timespec *pTime, long long ns)
+{
+    long long total_ns = pTime->tv_nsec + ns;
+    pTime->tv_sec += total_ns / NS_PER_SECOND;
+    pTime->tv_nsec = total_ns % NS_PER_SECOND;
+}
+
+// Scans on absolute deadlines; a scan that runs past whole periods skips
+// them rather than bursting to catch up.
+static void *scan_thread_function(void *arg)
+{
+    (void)arg;
+    Trace_setThreadName("tla2024 scan");
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    while (!atomic_load(&should_stop))
+    {
+        unsigned mask = atomic_load(&open_mask);
+        bool switch_mux = (mask & (mask - 1)) != 0; // More than one channel open
+        for (int channel = 0; channel < TLA2024_NUM_CHANNELS; channel++)
+        {
+            if (mask & (1u << channel))
+            {
+                scan_channel(channel, switch_mux);
+            }
+        }
+
+        long long period_ns = atomic_load(&scan_period_ns);
+        timespec_add_ns(&deadline, period_ns);
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long behind_ns = (now.tv_sec - deadline.tv_sec) * NS_PER_SECOND +
+                              (now.tv_nsec - deadline.tv_nsec);
+        if (behind_ns >= period_ns)
+        {
+            timespec_add_ns(&deadline, behind_ns / period_ns * period_ns);
+        }
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+        {
+        }
+    }
+    return NULL;
+}
+
+// Must hold open_lock
+static void update_schedule(void)
+{
+    unsigned mask = 0;
+    int max_rate = 1;
+    for (int channel = 0; channel < TLA2024_NUM_CHANNELS; channel++)
+    {
+        if (channel_rates[channel] > 0)
+        {
+            mask |= 1u << channel;
+            if (channel_rates[channel] > max_rate)
+            {
+                max_rate = channel_rates[channel];
+            }
+        }
+    }
+    atomic_store(&scan_period_ns, NS_PER_SECOND / max_rate);
+    atomic_store(&open_mask, mask);
+}
+
+static bool open_device(void)
+{
+    pBus = I2c_openBus(I2CDRV_LINUX_BUS);
+    if (!pBus)
+    {
+        return false;
+    }
+
+    selected_channel = NO_CHANNEL;
+    reported_error = false;
+    return true;
+}
+
+bool Tla2024_openChannel(int channel, int scans_per_second)
+{
+    assert(channel >= 0 && channel < TLA2024_NUM_CHANNELS);
+    assert(scans_per_second > 0 && scans_per_second <= MAX_SCANS_PER_SECOND);
+
+    pthread_mutex_lock(&open_lock);
+    assert(channel_rates[channel] == 0);
+
+    if (num_open == 0)
+    {
+        if (!open_device())
+        {
+            pthread_mutex_unlock(&open_lock);
+            return false;
+        }
+    }
+
+    atomic_store(&slots[channel], 0);
+    channel_rates[channel] = scans_per_second;
+    update_schedule();
+
+    if (num_open++ == 0)
+    {
+        atomic_store(&should_stop, false);
+        pthread_create(&scan_thread, NULL, scan_thread_function, NULL);
+    }
+    pthread_mutex_unlock(&open_lock);
+    return true;
+}
+
+void Tla2024_closeChannel(int channel)
+{
+    assert(channel >= 0 && channel < TLA2024_NUM_CHANNELS);
+
+    pthread_mutex_lock(&open_lock);
+    assert(channel_rates[channel] > 0);
+    channel_rates[channel] = 0;
+    update_schedule();
+
+    if (--num_open == 0)
+    {
+        atomic_store(&should_stop, true);
+        pthread_join(scan_thread, NULL);
+        I2c_closeBus(pBus);
+        pBus = NULL;
+    }
+    pthread_mutex_unlock(&open_lock);
+}
+
+Tla2024_reading_t Tla2024_read(int channel)
+{
+    assert(channel >= 0 && channel < TLA2024_NUM_CHANNELS);
+
+    uint64_t slot = atomic_load_explicit(&slots[channel], memory_order_acquire);
+    Tla2024_reading_t reading = {
+        .code = slot & SLOT_CODE_MASK,
+        .sequence = (uint32_t)(slot >> SLOT_SEQUENCE_SHIFT),
+    };
+    return reading;
+}
@@ -0,0 +1,294 @@
+// Per-thread trace rings and the Chrome trace-event JSON writer.
+// A thread gets its ring on its first event recorded while tracing is on,
+// so threads cost no memory while it is off. Only that thread writes it:
+// it fills the slot at `head`, then publishes it by advancing `head`.
+// The dumper copies the newest events and then checks that the thread did
+// not lap the ring onto what it copied, like the Sampler's archive.
+
+#define _GNU_SOURCE // gettid(), pthread_getname_np()
+#include "hal/trace.h"
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_THREADS 32
+#define MAX_THREAD_NAME 16
+#define MAX_PATH_LENGTH 256
+#define NS_PER_US 1000.0
+
+typedef struct {
+    uint64_t timestamp; // CycleClock ticks
+    uint64_t value;     // Span duration in ticks, or counter value
+    const char *name;
+    enum Trace_eventType type;
+} trace_event_t;
+
+typedef struct {
+    atomic_ullong head; // Number of events ever recorded
+    pid_t tid;
+    char thread_name[MAX_THREAD_NAME];
+    trace_event_t events[TRACE_EVENTS_PER_THREAD];
+} thread_ring_t;
+
+atomic_bool Trace_enabled = false;
+
+// Rings are registered once and live until cleanup, so the dumper can
+// still read threads that have exited
+static thread_ring_t *rings[MAX_THREADS];
+static atomic_int num_rings = 0;
+static atomic_llong dropped_threads = 0;
+static _Thread_local thread_ring_t *pThreadRing = NULL;
+static _Thread_local char thread_name[MAX_THREAD_NAME]; // From Trace_setThreadName()
+
+static char dump_path[MAX_PATH_LENGTH];
+static pthread_t dump_thread;
+static sem_t dump_request;
+static volatile bool should_stop = false;
+static bool is_initialized = false;
+
+static thread_ring_t *get_thread_ring(void);
+static void *dump_thread_function(void *arg);
+static void on_dump_signal(int sig);
+static void write_ring(FILE *pFile, thread_ring_t *pRing, bool *pFirst);
+
+void Trace_init(const char *path, bool enabled)
+{
+    CycleClock_init();
+    snprintf(dump_path, sizeof(dump_path), "%s", path);
+
+    sem_init(&dump_request, 0, 0);
+    should_stop = false;
+    pthread_create(&dump_thread, NULL, dump_thread_function, NULL);
+
+    struct sigaction action = {0};
+    action.sa_handler = on_dump_signal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+
+    is_initialized = true;
+    Trace_setEnabled(enabled);
+    printf("Trace: %s; kill -USR1 %d writes %s\n",
+           enabled ? "recording" : "off", (int)getpid(), dump_path);
+}
+
+void Trace_cleanup(void)
+{
+    if (!is_initialized)
+    {
+        return;
+    }
+    Trace_setEnabled(false);
+    signal(SIGUSR1, SIG_DFL);
+
+    should_stop = true;
+    sem_post(&dump_request);
+    pthread_join(dump_thread, NULL);
+    sem_destroy(&dump_request);
+
+    // Threads that recorded events have been joined by now
+    int count = atomic_load(&num_rings);
+    for (int i = 0; i < count && i < MAX_THREADS; i++)
+    {
+        free(rings[i]);
+        rings[i] = NULL;
+    }
+    atomic_store(&num_rings, 0);
+    is_initialized = false;
+}
+
+void Trace_setEnabled(bool enabled)
+{
+    atomic_store(&Trace_enabled, enabled);
+}
+
+void Trace_setThreadName(const char *name)
+{
+    // Kept for the ring, which is only created once there is an event
+    snprintf(thread_name, sizeof(thread_name), "%s", name);
+    if (pThreadRing)
+    {
+        snprintf(pThreadRing->thread_name, sizeof(pThreadRing->thread_name), "%s", name);
+    }
+}
+
+void Trace_requestDump(void)
+{
+    if (is_initialized)
+    {
+        sem_post(&dump_request);
+    }
+}
+
+void Trace_record(enum Trace_eventType type, const char *name,
+                  uint64_t timestamp, uint64_t value)
+{
+    thread_ring_t *pRing = get_thread_ring();
+    if (!pRing)
+    {
+        return;
+    }
+
+    unsigned long long head = atomic_load_explicit(&pRing->head, memory_order_relaxed);
+    trace_event_t *pEvent = &pRing->events[head & (TRACE_EVENTS_PER_THREAD - 1)];
+    pEvent->timestamp = timestamp;
+    pEvent->value = value;
+    pEvent->name = name;
+    pEvent->type = type;
+    atomic_store_explicit(&pRing->head, head + 1, memory_order_release);
+}
+
+// The calling thread's ring, created on first use. NULL if out of rings
+// or memory: that thread's events are then dropped.
+static thread_ring_t *get_thread_ring(void)
+{
+    if (pThreadRing)
+    {
+        return pThreadRing;
+    }
+
+    int index = atomic_fetch_add(&num_rings, 1);
+    if (index >= MAX_THREADS)
+    {
+        atomic_fetch_sub(&num_rings, 1);
+        atomic_fetch_add(&dropped_threads, 1);
+        return NULL;
+    }
+    thread_ring_t *pRing = calloc(1, sizeof(*pRing));
+    if (!pRing)
+    {
+        perror("Trace: unable to allocate thread ring");
+        exit(EXIT_FAILURE);
+    }
+    pRing->tid = gettid();
+    if (thread_name[0] != '\0')
+    {
+        memcpy(pRing->thread_name, thread_name, sizeof(pRing->thread_name));
+    }
+    else
+    {
+        pthread_getname_np(pthread_self(), pRing->thread_name, sizeof(pRing->thread_name));
+    }
+
+    // Publish: the dumper reads rings[i] for i < num_rings, and skips
+    // slots whose ring is not stored yet
+    __atomic_store_n(&rings[index], pRing, __ATOMIC_RELEASE);
+    pThreadRing = pRing;
+    return pRing;
+}
+
+static void on_dump_signal(int sig)
+{
+    (void)sig;
+    int saved_errno = errno;
+    Trace_requestDump();
+    errno = saved_errno;
+}
+
+static void *dump_thread_function(void *arg)
+{
+    (void)arg;
+    while (true)
+    {
+        while (sem_wait(&dump_request) != 0 && errno == EINTR)
+        {
+        }
+        if (should_stop)
+        {
+            break;
+        }
+        if (Trace_dump(dump_path))
+        {
+            printf("Trace: wrote %s\n", dump_path);
+        }
+    }
+    return NULL;
+}
+
+bool Trace_dump(const char *path)
+{
+    FILE *pFile = fopen(path, "w");
+    if (!pFile)
+    {
+        perror("Trace: unable to open dump file");
+        return false;
+    }
+
+    fprintf(pFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    int count = atomic_load(&num_rings);
+    for (int i = 0; i < count && i < MAX_THREADS; i++)
+    {
+        thread_ring_t *pRing = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+        if (pRing)
+        {
+            write_ring(pFile, pRing, &first);
+        }
+    }
+    fprintf(pFile, "\n]}\n");
+
+    if (atomic_load(&dropped_threads) > 0)
+    {
+        printf("Trace: %lld threads not traced (limit %d)\n",
+               (long long)atomic_load(&dropped_threads), MAX_THREADS);
+    }
+    return fclose(pFile) == 0;
+}
+
+// Write one thread's name and its events still in the ring
+static void write_ring(FILE *pFile, thread_ring_t *pRing, bool *pFirst)
+{
+    static trace_event_t events[TRACE_EVENTS_PER_THREAD];
+    int pid = (int)getpid();
+
+    // Copy the newest events, then keep only those the thread did not
+    // overwrite while we copied
+    unsigned long long head = atomic_load_explicit(&pRing->head, memory_order_acquire);
+    unsigned long long first = (head > TRACE_EVENTS_PER_THREAD) ? head - TRACE_EVENTS_PER_THREAD : 0;
+    for (unsigned long long i = first; i < head; i++)
+    {
+        events[i - first] = pRing->events[i & (TRACE_EVENTS_PER_THREAD - 1)];
+    }
+    atomic_thread_fence(memory_order_acquire);
+    unsigned long long now = atomic_load_explicit(&pRing->head, memory_order_relaxed);
+    unsigned long long valid_from = (now > TRACE_EVENTS_PER_THREAD) ? now - TRACE_EVENTS_PER_THREAD + 1 : 0;
+    if (valid_from < first)
+    {
+        valid_from = first;
+    }
+
+    fprintf(pFile, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s\"}}",
+            *pFirst ? "" : ",\n", pid, (int)pRing->tid, pRing->thread_name);
+    *pFirst = false;
+
+    for (unsigned long long i = valid_from; i < head; i++)
+    {
+        const trace_event_t *pEvent = &events[i - first];
+        double ts_us = CycleClock_toMonotonicNs(pEvent->timestamp) / NS_PER_US;
+        switch (pEvent->type)
+        {
+        case TRACE_EVENT_SPAN:
+            fprintf(pFile, ",\n{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f}",
+                    pEvent->name, pid, (int)pRing->tid, ts_us,
+                    CycleClock_ticksToNs(pEvent->value) / NS_PER_US);
+            break;
+        case TRACE_EVENT_INSTANT:
+            fprintf(pFile, ",\n{\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s\",\"pid\":%d,"
+                    "\"tid\":%d,\"ts\":%.3f}",
+                    pEvent->name, pid, (int)pRing->tid, ts_us);
+            break;
+        case TRACE_EVENT_COUNTER:
+            fprintf(pFile, ",\n{\"ph\":\"C\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,"
+                    "\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+                    pEvent->name, pid, (int)pRing->tid, ts_us, (long long)pEvent->value);
+            break;
+        }
+    }
+}
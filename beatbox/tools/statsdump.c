@@ -0,0 +1,146 @@
+// Print the live metrics of a running beatbox from its shared-memory
+// metrics segment, without disturbing the app (it only reads).
+// Usage: statsdump [interval seconds]
+// With an interval, repeats until interrupted and adds per-second rates
+// for counters and histograms.
+
+#include "hal/metrics.h"
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static const char *type_name(uint32_t type)
+{
+    switch (type)
+    {
+    case METRICS_COUNTER:
+        return "counter";
+    case METRICS_GAUGE:
+        return "gauge";
+    case METRICS_HISTOGRAM:
+        return "histogram";
+    default:
+        return "?";
+    }
+}
+
+// Upper edge of a histogram bucket (bucket i holds values below 2^i)
+static long long bucket_limit(int bucket)
+{
+    return (bucket == 0) ? 0 : (1LL << bucket) - 1;
+}
+
+// Smallest bucket limit at or below which `fraction` of the values fall
+static long long histogram_percentile(const long long *buckets, long long count,
+                                      double fraction)
+{
+    long long seen = 0;
+    for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen >= fraction * count && seen > 0)
+        {
+            return bucket_limit(i);
+        }
+    }
+    return bucket_limit(METRICS_HISTOGRAM_BUCKETS - 1);
+}
+
+static void print_metric(const Metrics_metric_t *pMetric, long long previous,
+                         double interval_s)
+{
+    long long value = atomic_load_explicit(&pMetric->value, memory_order_relaxed);
+    printf("%-32s %-9s %12lld", pMetric->name, type_name(pMetric->type), value);
+    if (interval_s > 0 && pMetric->type != METRICS_GAUGE)
+    {
+        printf("  %10.1f/s", (value - previous) / interval_s);
+    }
+
+    if (pMetric->type == METRICS_HISTOGRAM && value > 0)
+    {
+        long long buckets[METRICS_HISTOGRAM_BUCKETS];
+        long long count = 0;
+        int max_bucket = 0;
+        for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+        {
+            buckets[i] = atomic_load_explicit(&pMetric->buckets[i], memory_order_relaxed);
+            count += buckets[i];
+            if (buckets[i] > 0)
+            {
+                max_bucket = i;
+            }
+        }
+        long long sum = atomic_load_explicit(&pMetric->sum, memory_order_relaxed);
+        printf("  avg %.1f  p50 <=%lld  p99 <=%lld  max <=%lld",
+               (double)sum / value,
+               histogram_percentile(buckets, count, 0.50),
+               histogram_percentile(buckets, count, 0.99),
+               bucket_limit(max_bucket));
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    double interval_s = (argc >= 2) ? atof(argv[1]) : 0;
+
+    int fd = shm_open(METRICS_SHM_NAME, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        perror("Unable to open " METRICS_SHM_NAME " (is beatbox running?)");
+        return EXIT_FAILURE;
+    }
+    const Metrics_segment_t *pSegment = mmap(NULL, sizeof(*pSegment), PROT_READ,
+                                             MAP_SHARED, fd, 0);
+    close(fd);
+    if (pSegment == MAP_FAILED)
+    {
+        perror("Unable to map metrics");
+        return EXIT_FAILURE;
+    }
+    if (pSegment->magic != METRICS_MAGIC)
+    {
+        fprintf(stderr, "Metrics segment is not initialized\n");
+        return EXIT_FAILURE;
+    }
+    if (pSegment->version != METRICS_VERSION ||
+        pSegment->metric_size != sizeof(Metrics_metric_t))
+    {
+        fprintf(stderr, "Unsupported metrics layout version %u\n", pSegment->version);
+        return EXIT_FAILURE;
+    }
+
+    static long long previous[METRICS_MAX_ENTRIES];
+    bool first = true;
+    do
+    {
+        unsigned int count = atomic_load_explicit(&pSegment->num_entries, memory_order_acquire);
+        if (count > pSegment->max_entries || count > METRICS_MAX_ENTRIES)
+        {
+            count = METRICS_MAX_ENTRIES;
+        }
+
+        printf("beatbox pid %d: %u metrics\n", pSegment->pid, count);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            const Metrics_metric_t *pMetric = &pSegment->metrics[i];
+            print_metric(pMetric, previous[i], first ? 0 : interval_s);
+            previous[i] = atomic_load_explicit(&pMetric->value, memory_order_relaxed);
+        }
+        first = false;
+
+        if (interval_s > 0)
+        {
+            printf("\n");
+            fflush(stdout);
+            usleep(interval_s * 1000000);
+        }
+    } while (interval_s > 0);
+
+    munmap((void *)pSegment, sizeof(*pSegment));
+    return EXIT_SUCCESS;
+}